@@ -0,0 +1,391 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <net/ethernet.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Adds a buffer to a running Internet checksum (RFC 1071) without folding.
+ *
+ * @param sum Partial sum so far.
+ * @param data Buffer to add.
+ * @param len Length of the buffer in bytes.
+ * @return uint32_t Updated partial sum.
+ */
+inline uint32_t csum_add(uint32_t sum, const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    while (len > 1) {
+        uint16_t word;
+        memcpy(&word, p, 2);
+        sum += word;
+        p += 2;
+        len -= 2;
+    }
+    if (len == 1) {
+        uint16_t word = 0;
+        memcpy(&word, p, 1);
+        sum += word;
+    }
+    return sum;
+}
+
+/**
+ * @brief Folds a partial sum into the final one's-complement checksum.
+ */
+inline uint16_t csum_fold(uint32_t sum) {
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<uint16_t>(~sum);
+}
+
+/**
+ * @brief An ICMP/ICMPv6 error message and the transport header it quotes.
+ */
+struct IcmpError {
+    uint8_t type;
+    uint8_t code;
+    const uint8_t *quote;
+    size_t quote_len;
+};
+
+/**
+ * @brief Address-family traits for IPv4.
+ *
+ * Probes are sent through an IP_HDRINCL raw socket that also receives the replies.
+ */
+struct IPv4Family {
+    using addr_type = in_addr;
+    using header_type = struct iphdr;
+    static constexpr int family = AF_INET;
+    static constexpr bool socket_receives = true;
+    static constexpr int icmp_protocol = IPPROTO_ICMP;
+    static constexpr uint8_t unreach_type = ICMP_DEST_UNREACH;
+    static constexpr uint8_t port_unreach_code = ICMP_PORT_UNREACH;
+    static constexpr uint16_t ethertype = ETHERTYPE_IP;
+
+    static bool parse(const std::string &text, addr_type &out) {
+        return inet_pton(AF_INET, text.c_str(), &out) == 1;
+    }
+
+    static bool equal(const addr_type &a, const addr_type &b) {
+        return a.s_addr == b.s_addr;
+    }
+
+    static socklen_t to_sockaddr(const addr_type &addr, sockaddr_storage &out) {
+        memset(&out, 0, sizeof(out));
+        auto *sin = reinterpret_cast<sockaddr_in*>(&out);
+        sin->sin_family = AF_INET;
+        sin->sin_addr = addr;
+        return sizeof(sockaddr_in);
+    }
+
+    /**
+     * @brief Writes a complete IPv4 header including its checksum.
+     */
+    static void write_header(uint8_t *buf, const addr_type &src, const addr_type &dst,
+                             uint8_t proto, size_t payload_len) {
+        struct iphdr *iph = reinterpret_cast<struct iphdr*>(buf);
+        memset(iph, 0, sizeof(*iph));
+        iph->ihl = 5;
+        iph->version = 4;
+        iph->tot_len = htons(sizeof(struct iphdr) + payload_len);
+        iph->ttl = 64;
+        iph->protocol = proto;
+        iph->saddr = src.s_addr;
+        iph->daddr = dst.s_addr;
+        iph->check = csum_fold(csum_add(0, iph, sizeof(*iph)));
+    }
+
+    static uint32_t pseudo_sum(const addr_type &src, const addr_type &dst, uint8_t proto, size_t len) {
+        uint32_t sum = csum_add(0, &src, sizeof(src));
+        sum = csum_add(sum, &dst, sizeof(dst));
+        sum += htons(proto);
+        sum += htons(static_cast<uint16_t>(len));
+        return sum;
+    }
+
+    /**
+     * @brief Returns the transport payload of a received packet sent by `from` with protocol `proto`.
+     *
+     * @return const uint8_t* Start of the transport header, nullptr if the packet does not match.
+     */
+    static const uint8_t *l4_from(const uint8_t *pkt, size_t len, uint8_t proto,
+                                  const addr_type &from, size_t &l4_len) {
+        if (len < sizeof(struct iphdr)) return nullptr;
+        const struct iphdr *iph = reinterpret_cast<const struct iphdr*>(pkt);
+        size_t hlen = iph->ihl * 4;
+        if (iph->version != 4 || iph->protocol != proto || iph->saddr != from.s_addr || len < hlen)
+            return nullptr;
+        l4_len = len - hlen;
+        return pkt + hlen;
+    }
+
+    /**
+     * @brief Splits a network-layer packet into its addresses and transport payload.
+     *
+     * @return const uint8_t* Start of the transport header, nullptr if the packet is malformed.
+     */
+    static const uint8_t *transport(const uint8_t *pkt, size_t len, uint8_t &proto,
+                                    addr_type &src, addr_type &dst, size_t &l4_len) {
+        if (len < sizeof(struct iphdr)) return nullptr;
+        const struct iphdr *iph = reinterpret_cast<const struct iphdr*>(pkt);
+        size_t hlen = iph->ihl * 4;
+        if (iph->version != 4 || hlen < sizeof(struct iphdr) || len < hlen) return nullptr;
+        proto = iph->protocol;
+        src.s_addr = iph->saddr;
+        dst.s_addr = iph->daddr;
+        l4_len = len - hlen;
+        return pkt + hlen;
+    }
+
+    /**
+     * @brief Reads the destination of the packet quoted in an ICMP error message.
+     */
+    static bool quoted_destination(const uint8_t *icmp, size_t len, addr_type &out) {
+        if (len < sizeof(struct icmphdr) + sizeof(struct iphdr)) return false;
+        out.s_addr = reinterpret_cast<const struct iphdr*>(icmp + sizeof(struct icmphdr))->daddr;
+        return true;
+    }
+
+    /**
+     * @brief Locates the ICMP message in a packet read from a raw IPPROTO_ICMP socket.
+     *
+     * IPv4 raw sockets deliver the IP header as well, so it is skipped here.
+     */
+    static const uint8_t *raw_icmp_message(const uint8_t *pkt, size_t len, size_t &icmp_len) {
+        if (len < sizeof(struct iphdr)) return nullptr;
+        size_t hlen = reinterpret_cast<const struct iphdr*>(pkt)->ihl * 4;
+        if (len < hlen) return nullptr;
+        icmp_len = len - hlen;
+        return pkt + hlen;
+    }
+
+    /**
+     * @brief Parses an ICMP error message and locates the transport header of the quoted probe.
+     *
+     * @param icmp Start of the ICMP message.
+     * @param len Length of the ICMP message.
+     * @param proto Protocol of the quoted packet.
+     * @param probe_dst Destination the quoted packet must have been sent to.
+     * @param out Parsed error.
+     * @return true If the message is an error quoting a packet of ours to probe_dst.
+     */
+    static bool parse_icmp_error(const uint8_t *icmp, size_t len, uint8_t proto,
+                                 const addr_type &probe_dst, IcmpError &out) {
+        if (len < sizeof(struct icmphdr) + sizeof(struct iphdr)) return false;
+        const struct icmphdr *icmph = reinterpret_cast<const struct icmphdr*>(icmp);
+        if (icmph->type != ICMP_DEST_UNREACH && icmph->type != ICMP_TIME_EXCEEDED) return false;
+        const uint8_t *inner = icmp + sizeof(struct icmphdr);
+        const struct iphdr *iph = reinterpret_cast<const struct iphdr*>(inner);
+        size_t hlen = iph->ihl * 4;
+        size_t avail = len - sizeof(struct icmphdr);
+        // RFC 792 guarantees the IP header plus the first 8 bytes of the transport header.
+        if (iph->protocol != proto || iph->daddr != probe_dst.s_addr || avail < hlen + 8) return false;
+        out.type = icmph->type;
+        out.code = icmph->code;
+        out.quote = inner + hlen;
+        out.quote_len = avail - hlen;
+        return true;
+    }
+};
+
+/**
+ * @brief Address-family traits for IPv6.
+ *
+ * Probes are sent through an IPPROTO_RAW socket with IPV6_HDRINCL; replies are captured with libpcap.
+ */
+struct IPv6Family {
+    using addr_type = in6_addr;
+    using header_type = struct ip6_hdr;
+    static constexpr int family = AF_INET6;
+    static constexpr bool socket_receives = false;
+    static constexpr int icmp_protocol = IPPROTO_ICMPV6;
+    static constexpr uint8_t unreach_type = ICMP6_DST_UNREACH;
+    static constexpr uint8_t port_unreach_code = ICMP6_DST_UNREACH_NOPORT;
+    static constexpr uint16_t ethertype = ETHERTYPE_IPV6;
+
+    static bool parse(const std::string &text, addr_type &out) {
+        return inet_pton(AF_INET6, text.c_str(), &out) == 1;
+    }
+
+    static bool equal(const addr_type &a, const addr_type &b) {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    static socklen_t to_sockaddr(const addr_type &addr, sockaddr_storage &out) {
+        memset(&out, 0, sizeof(out));
+        auto *sin6 = reinterpret_cast<sockaddr_in6*>(&out);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = addr;
+        return sizeof(sockaddr_in6);
+    }
+
+    static void write_header(uint8_t *buf, const addr_type &src, const addr_type &dst,
+                             uint8_t proto, size_t payload_len) {
+        struct ip6_hdr *ip6h = reinterpret_cast<struct ip6_hdr*>(buf);
+        memset(ip6h, 0, sizeof(*ip6h));
+        ip6h->ip6_flow = htonl(0x60000000);
+        ip6h->ip6_plen = htons(payload_len);
+        ip6h->ip6_nxt  = proto;
+        ip6h->ip6_hops = 64;
+        ip6h->ip6_src = src;
+        ip6h->ip6_dst = dst;
+    }
+
+    static uint32_t pseudo_sum(const addr_type &src, const addr_type &dst, uint8_t proto, size_t len) {
+        uint32_t sum = csum_add(0, &src, sizeof(src));
+        sum = csum_add(sum, &dst, sizeof(dst));
+        uint32_t len32 = htonl(static_cast<uint32_t>(len));
+        sum = csum_add(sum, &len32, sizeof(len32));
+        sum += htons(proto);
+        return sum;
+    }
+
+    static const uint8_t *l4_from(const uint8_t *pkt, size_t len, uint8_t proto,
+                                  const addr_type &from, size_t &l4_len) {
+        if (len < sizeof(struct ip6_hdr)) return nullptr;
+        const struct ip6_hdr *ip6h = reinterpret_cast<const struct ip6_hdr*>(pkt);
+        if (ip6h->ip6_nxt != proto || !equal(ip6h->ip6_src, from)) return nullptr;
+        l4_len = len - sizeof(struct ip6_hdr);
+        return pkt + sizeof(struct ip6_hdr);
+    }
+
+    static const uint8_t *transport(const uint8_t *pkt, size_t len, uint8_t &proto,
+                                    addr_type &src, addr_type &dst, size_t &l4_len) {
+        if (len < sizeof(struct ip6_hdr)) return nullptr;
+        const struct ip6_hdr *ip6h = reinterpret_cast<const struct ip6_hdr*>(pkt);
+        if ((pkt[0] >> 4) != 6) return nullptr;
+        proto = ip6h->ip6_nxt;
+        src = ip6h->ip6_src;
+        dst = ip6h->ip6_dst;
+        l4_len = len - sizeof(struct ip6_hdr);
+        return pkt + sizeof(struct ip6_hdr);
+    }
+
+    static bool quoted_destination(const uint8_t *icmp, size_t len, addr_type &out) {
+        if (len < sizeof(struct icmp6_hdr) + sizeof(struct ip6_hdr)) return false;
+        out = reinterpret_cast<const struct ip6_hdr*>(icmp + sizeof(struct icmp6_hdr))->ip6_dst;
+        return true;
+    }
+
+    /**
+     * @brief Locates the ICMPv6 message in a packet read from a raw IPPROTO_ICMPV6 socket,
+     * which delivers the message without the IPv6 header.
+     */
+    static const uint8_t *raw_icmp_message(const uint8_t *pkt, size_t len, size_t &icmp_len) {
+        icmp_len = len;
+        return pkt;
+    }
+
+    static bool parse_icmp_error(const uint8_t *icmp, size_t len, uint8_t proto,
+                                 const addr_type &probe_dst, IcmpError &out) {
+        if (len < sizeof(struct icmp6_hdr) + sizeof(struct ip6_hdr) + 8) return false;
+        const struct icmp6_hdr *icmp6h = reinterpret_cast<const struct icmp6_hdr*>(icmp);
+        if (icmp6h->icmp6_type != ICMP6_DST_UNREACH && icmp6h->icmp6_type != ICMP6_TIME_EXCEEDED) return false;
+        const uint8_t *inner = icmp + sizeof(struct icmp6_hdr);
+        const struct ip6_hdr *ip6h = reinterpret_cast<const struct ip6_hdr*>(inner);
+        if (ip6h->ip6_nxt != proto || !equal(ip6h->ip6_dst, probe_dst)) return false;
+        out.type = icmp6h->icmp6_type;
+        out.code = icmp6h->icmp6_code;
+        out.quote = inner + sizeof(struct ip6_hdr);
+        out.quote_len = len - sizeof(struct icmp6_hdr) - sizeof(struct ip6_hdr);
+        return true;
+    }
+};
+
+/**
+ * @brief Prebuilt TCP probe for one source/destination pair.
+ *
+ * The network header and the pseudo-header checksum are computed once; each probe only
+ * rewrites ports, sequence number and flags in place.
+ */
+template <class AF>
+class TcpProbe {
+private:
+    static constexpr size_t L3_LEN = sizeof(typename AF::header_type);
+    uint8_t packet[L3_LEN + sizeof(struct tcphdr)];
+    uint32_t pseudo;
+
+public:
+    TcpProbe(const typename AF::addr_type &src, const typename AF::addr_type &dst) {
+        memset(packet, 0, sizeof(packet));
+        AF::write_header(packet, src, dst, IPPROTO_TCP, sizeof(struct tcphdr));
+        pseudo = AF::pseudo_sum(src, dst, IPPROTO_TCP, sizeof(struct tcphdr));
+        struct tcphdr *tcph = reinterpret_cast<struct tcphdr*>(packet + L3_LEN);
+        tcph->doff = 5;
+        tcph->window = htons(65535);
+    }
+
+    /**
+     * @brief Fills in the per-probe TCP fields and returns the finished packet.
+     *
+     * @param flags TCP flags (TH_SYN, TH_ACK, ...).
+     */
+    const uint8_t *build(uint16_t src_port, uint16_t dst_port, uint32_t seq, uint8_t flags) {
+        struct tcphdr *tcph = reinterpret_cast<struct tcphdr*>(packet + L3_LEN);
+        tcph->source = htons(src_port);
+        tcph->dest = htons(dst_port);
+        tcph->seq = htonl(seq);
+        tcph->ack_seq = (flags & TH_ACK) ? htonl(seq ^ 0x5a5a5a5a) : 0;
+        tcph->th_flags = flags;
+        tcph->check = 0;
+        tcph->check = csum_fold(csum_add(pseudo, tcph, sizeof(*tcph)));
+        return packet;
+    }
+
+    size_t size() const { return sizeof(packet); }
+};
+
+/**
+ * @brief Outcome of matching one received packet against an outstanding TCP probe.
+ */
+enum class TcpReply { None, Open, Closed, Filtered };
+
+/**
+ * @brief Classifies a received network-layer packet as the answer to a TCP probe.
+ *
+ * Besides SYN-ACK and RST from the target, ICMP/ICMPv6 destination-unreachable errors from
+ * any sender count when they quote the probe's destination and ports.
+ *
+ * @param pkt Packet starting at the IP/IPv6 header.
+ * @param len Length of the packet.
+ * @param dst Address the probe was sent to.
+ * @param src_port Source port of the probe.
+ * @param dst_port Destination port of the probe.
+ * @return TcpReply Open on SYN-ACK, Closed on RST, Filtered on an unreachable error,
+ *         None if the packet is unrelated.
+ */
+template <class AF>
+TcpReply classify_tcp_reply(const uint8_t *pkt, size_t len, const typename AF::addr_type &dst,
+                            uint16_t src_port, uint16_t dst_port) {
+    size_t l4_len;
+    const uint8_t *l4 = AF::l4_from(pkt, len, IPPROTO_TCP, dst, l4_len);
+    if (l4) {
+        if (l4_len < sizeof(struct tcphdr)) return TcpReply::None;
+        const struct tcphdr *tcph = reinterpret_cast<const struct tcphdr*>(l4);
+        if (ntohs(tcph->dest) != src_port || ntohs(tcph->source) != dst_port) return TcpReply::None;
+        if (tcph->syn && tcph->ack) return TcpReply::Open;
+        if (tcph->rst) return TcpReply::Closed;
+        return TcpReply::None;
+    }
+
+    uint8_t proto;
+    typename AF::addr_type from, to;
+    l4 = AF::transport(pkt, len, proto, from, to, l4_len);
+    IcmpError err;
+    if (!l4 || proto != AF::icmp_protocol || !AF::parse_icmp_error(l4, l4_len, IPPROTO_TCP, dst, err))
+        return TcpReply::None;
+    // The quote holds at least the 8 bytes with both ports.
+    const struct tcphdr *quoted = reinterpret_cast<const struct tcphdr*>(err.quote);
+    if (ntohs(quoted->source) != src_port || ntohs(quoted->dest) != dst_port) return TcpReply::None;
+    return err.type == AF::unreach_type ? TcpReply::Filtered : TcpReply::None;
+}
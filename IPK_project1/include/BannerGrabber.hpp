@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Pipeline stage that reads the first bytes a service sends on an open TCP port.
+ *
+ * Open ports are handed over with submit(), which only queues them, so the probing threads
+ * never wait for it. A single thread keeps up to `max_inflight` non-blocking connections in
+ * an epoll set, reads the first chunk each one sends within `timeout_ms` and reports the port
+ * as open with the first line of that data (or without a banner if nothing arrived).
+ */
+class BannerGrabber {
+private:
+    static const size_t BANNER_BYTES = 512;
+    static const size_t BANNER_SHOWN = 80;
+
+    struct Pending {
+        std::string ip;
+        int port;
+    };
+
+    struct Slot {
+        int fd = -1;
+        std::string ip;
+        int port = 0;
+        bool connected = false;
+        uint32_t gen = 0;
+    };
+
+    struct Deadline {
+        std::chrono::steady_clock::time_point when;
+        uint32_t slot;
+        uint32_t gen;
+        bool operator>(const Deadline &other) const { return when > other.when; }
+    };
+
+    int max_inflight;
+    int timeout_ms;
+
+    std::mutex queue_mutex;
+    std::deque<Pending> queue;
+    bool closing = false;
+    int wake_fd = -1;
+    int epfd = -1;
+    std::thread worker;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+    int inflight = 0;
+
+    void run();
+    void start(const Pending &target);
+    void finish(uint32_t slot, const std::string &banner);
+    int next_timeout_ms();
+
+public:
+    BannerGrabber(int max_inflight = 256, int timeout_ms = 2000);
+    ~BannerGrabber();
+
+    /**
+     * @brief Queues an open port for banner grabbing. Never blocks on the network.
+     */
+    void submit(const std::string &ip, int port);
+
+    /**
+     * @brief Waits until every submitted port has been reported, then stops the thread.
+     */
+    void close();
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <iostream>
+
+/**
+ * @brief Port states from a previous scan, used to plan and diff an incremental rescan.
+ *
+ * The baseline file is the scanner's own output (`<ip> <port> <proto> <state>` lines).
+ * Previously open ports are probed first, runs of ports with the same closed or filtered
+ * state are only sampled, and results that match the baseline are not printed.
+ */
+class Baseline {
+public:
+    enum State : uint8_t { UNKNOWN = 0, OPEN, CLOSED, FILTERED };
+
+private:
+    // (ip, proto) -> state of every port, indexed by port number.
+    std::map<std::pair<std::string, std::string>, std::vector<uint8_t>> hosts;
+    uint64_t changed = 0;
+    uint64_t unchanged = 0;
+
+public:
+    /**
+     * @brief Loads a previous result file. A missing file yields an empty baseline.
+     * @return true If the file was read or did not exist yet.
+     */
+    bool load(const std::string &path);
+
+    /**
+     * @brief Writes the merged states back in the normal output format.
+     * @return true On success.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Orders and samples the ports to probe for one host and protocol.
+     *
+     * @param ip Target address.
+     * @param proto "tcp" or "udp".
+     * @param ports Requested ports.
+     * @param fraction Share of each stable closed/filtered run to probe (at least one port per run).
+     * @return std::vector<int> Previously open ports, then unknown ports, then the sampled runs.
+     */
+    std::vector<int> plan(const std::string &ip, const char *proto, const std::vector<int> &ports,
+                          double fraction) const;
+
+    /**
+     * @brief Records a fresh result.
+     *
+     * @return State The state the port had in the baseline (UNKNOWN if it was not scanned).
+     */
+    State update(const std::string &ip, int port, const char *proto, const char *state);
+
+    uint64_t changed_count() const { return changed; }
+    uint64_t unchanged_count() const { return unchanged; }
+
+    static const char *name(State s);
+    static State parse_state(const std::string &s);
+};
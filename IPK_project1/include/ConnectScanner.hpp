@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <queue>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+/**
+ * @brief Unprivileged TCP scanner based on non-blocking connect().
+ *
+ * Keeps up to `max_inflight` connection attempts open at once, multiplexed with epoll.
+ * Port state is taken from SO_ERROR once the socket becomes writable; attempts that do not
+ * finish before their deadline are reported as filtered.
+ */
+class ConnectScanner {
+private:
+    struct Slot {
+        int fd = -1;
+        int port = 0;
+        uint32_t gen = 0;
+    };
+
+    struct Deadline {
+        std::chrono::steady_clock::time_point when;
+        uint32_t slot;
+        uint32_t gen;
+        bool operator>(const Deadline &other) const { return when > other.when; }
+    };
+
+    std::string dst_ip;
+    std::string src_ip;
+    std::vector<int> ports;
+    int timeout_ms;
+    int max_inflight;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+    int epfd = -1;
+    int inflight = 0;
+
+public:
+    ConnectScanner(const std::string& dst, const std::string& src, const std::vector<int>& p,
+                   int timeout, int max_inflight = 4096);
+    void scan();
+
+private:
+    int start_connect(int port, const sockaddr_storage &dst, socklen_t dst_len,
+                      const sockaddr_storage &src, socklen_t src_len);
+    void finish(uint32_t slot, const char *state);
+    int next_timeout_ms();
+};
+
+/**
+ * @brief Fills a sockaddr_storage from a textual IPv4 or IPv6 address.
+ * @return socklen_t Length of the filled address, 0 if the address is invalid.
+ */
+socklen_t make_sockaddr(const std::string &ip, int port, sockaddr_storage &out);
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+class DeadlinePlan {
+public:
+    enum Step { FULL = 0, ONE_PROBE, SHORT_WAIT, CUT };
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point deadline;
+    clock::time_point start;
+    size_t total;
+    size_t started = 0;
+    double probe_ns;
+    double probes_per_port = 1;
+    bool have_cost = false;
+    bool have_ports = false;
+    uint64_t probes = 0;
+    Step worst = FULL;
+    Step step = FULL;
+
+public:
+    DeadlinePlan(clock::time_point deadline, size_t ports, int initial_wait_ms);
+    bool next(int &limit, int &wait_ms, int floor_ms);
+    void record(int sent, clock::duration elapsed);
+    void print(const std::string &ip, const char *proto) const;
+    bool limited() const { return deadline != clock::time_point::max(); }
+};
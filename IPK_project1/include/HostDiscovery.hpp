@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Host discovery pre-pass run before the port scan.
+ *
+ * Sends ICMP/ICMPv6 echo requests, TCP SYN and ACK pings to common ports and, for targets on
+ * the local subnet of the selected interface, ARP requests or NDP neighbor solicitations.
+ * Probes for all targets go out at once; any reply sourced from a target marks it as up.
+ */
+class HostDiscovery {
+private:
+    std::string iface;
+    std::string src_ip;
+    std::string src_ip6;
+    int timeout_ms;
+
+    std::map<std::string, bool> up;
+    uint16_t ident;
+
+public:
+    HostDiscovery(const std::string& interface, const std::string& src, const std::string& src6, int timeout);
+
+    /**
+     * @brief Probes all addresses and returns those that answered.
+     *
+     * @param addrs Candidate addresses (IPv4 and IPv6 may be mixed).
+     * @return std::vector<std::string> Responsive addresses, in input order.
+     */
+    std::vector<std::string> alive(const std::vector<std::string>& addrs);
+
+private:
+    void mark(const std::string &addr);
+    bool all_up() const;
+};
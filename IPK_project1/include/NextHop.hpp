@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Link-layer addressing for frames sent straight to the interface.
+ */
+struct LinkTarget {
+    int ifindex = 0;
+    uint8_t src_mac[6] = {};
+    uint8_t dst_mac[6] = {};
+};
+
+/**
+ * @brief Resolves the Ethernet addresses for reaching a destination through an interface.
+ *
+ * The next hop is the route's gateway, or the destination itself when it is on-link. Its MAC
+ * comes from the kernel neighbour table; if there is no usable entry, one datagram to the next
+ * hop makes the kernel resolve it (ARP or NDP) and the table is read again for up to a second.
+ * On a loopback interface both addresses are zero.
+ *
+ * @param iface Interface the frames will be sent on.
+ * @param family AF_INET or AF_INET6.
+ * @param dst Destination address (in_addr or in6_addr).
+ * @param out Filled in on success.
+ * @return true If both addresses are known.
+ */
+bool resolve_link_target(const std::string &iface, int family, const void *dst, LinkTarget &out);
@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include <pcap.h>
+#include "ProbeIO.hpp"
+
+/**
+ * @brief Source of received network-layer packets for the reply classifiers.
+ */
+class PacketSource {
+public:
+    virtual ~PacketSource() = default;
+
+    /**
+     * @brief Waits for the next packet.
+     *
+     * @param pkt Set to the start of the IP/IPv6 header; valid until the next call.
+     * @param timeout_ms Maximum time to wait in milliseconds; 0 does not block.
+     * @param stamp If not null, set to the receive timestamp of the packet (CLOCK_REALTIME).
+     * @return ssize_t Length of the packet, -1 on timeout or error.
+     */
+    virtual ssize_t next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) = 0;
+
+    /**
+     * @brief Descriptor that polls readable when next() may return a packet.
+     */
+    virtual int fd() const = 0;
+};
+
+/**
+ * @brief Reads packets from the raw socket behind a probe backend.
+ */
+class SocketSource : public PacketSource {
+private:
+    ProbeIO &io;
+    uint8_t buffer[2048];
+
+public:
+    explicit SocketSource(ProbeIO &io) : io(io) {}
+    ssize_t next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) override;
+    int fd() const override { return io.poll_fd(); }
+};
+
+/**
+ * @brief Reads packets directly from a raw socket owned by the caller.
+ */
+class RawSocketSource : public PacketSource {
+private:
+    int sock;
+    uint8_t buffer[2048];
+
+public:
+    explicit RawSocketSource(int sock);
+    ssize_t next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) override;
+    int fd() const override { return sock; }
+};
+
+/**
+ * @brief Delivers packets from two sources, whichever has one first.
+ */
+class MergedSource : public PacketSource {
+private:
+    PacketSource &first;
+    PacketSource &second;
+
+public:
+    MergedSource(PacketSource &a, PacketSource &b) : first(a), second(b) {}
+    ssize_t next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) override;
+    int fd() const override { return first.fd(); }
+};
+
+/**
+ * @brief Reads packets from a live libpcap capture, stripping the link-layer header.
+ *
+ * Timestamps come from the capture itself, in nanoseconds where libpcap supports it.
+ */
+class PcapSource : public PacketSource {
+private:
+    pcap_t *handle;
+    int link_offset;
+    int capture_fd;
+    bool nano = false;
+
+    PcapSource(pcap_t *handle);
+
+public:
+    ~PcapSource() override;
+
+    /**
+     * @brief Opens a non-blocking, immediate-mode capture with a BPF filter.
+     *
+     * @return std::unique_ptr<PcapSource> nullptr on failure (error already printed).
+     */
+    static std::unique_ptr<PcapSource> open_live(const std::string &iface, const std::string &filter);
+
+    ssize_t next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) override;
+    int fd() const override { return capture_fd; }
+};
+
+/**
+ * @brief Returns the link-layer header length for a pcap datalink type, -1 if unsupported.
+ */
+int link_header_length(int dlt);
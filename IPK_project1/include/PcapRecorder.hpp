@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#include <pcap.h>
+#include "AddressFamily.hpp"
+
+class PcapRecorder {
+private:
+    static const size_t SLOTS = 32768;
+    static const size_t SNAPLEN = 512;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        timespec stamp;
+        uint32_t len;
+        uint32_t caplen;
+        uint8_t data[SNAPLEN];
+    };
+
+    std::unique_ptr<Slot[]> ring;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) size_t dequeue_pos = 0;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> stopping{false};
+    uint64_t written = 0;
+
+    pcap_t *dead = nullptr;
+    pcap_dumper_t *dumper = nullptr;
+    std::thread writer;
+
+    PcapRecorder();
+    bool write_next();
+    void write_loop();
+
+public:
+    ~PcapRecorder();
+    static std::unique_ptr<PcapRecorder> open(const std::string &path);
+    void record(const void *pkt, size_t len, const timespec &stamp);
+    void close();
+};
+
+void set_packet_recorder(PcapRecorder *recorder);
+bool packet_recording();
+void record_packet(const void *pkt, size_t len, const timespec &stamp);
+
+/**
+ * @brief Tells whether a received packet belongs to the scan of `target`.
+ *
+ * True for packets sent by the target and for ICMP/ICMPv6 messages quoting a packet to it,
+ * whether or not they answer one of the probes; other traffic seen by the raw sockets is
+ * not recorded.
+ */
+template <class AF>
+bool concerns_target(const uint8_t *pkt, size_t len, const typename AF::addr_type &target) {
+    uint8_t proto;
+    typename AF::addr_type src, dst, quoted;
+    size_t l4_len;
+    const uint8_t *l4 = AF::transport(pkt, len, proto, src, dst, l4_len);
+    if (!l4) return false;
+    if (AF::equal(src, target)) return true;
+    return proto == AF::icmp_protocol && AF::quoted_destination(l4, l4_len, quoted) && AF::equal(quoted, target);
+}
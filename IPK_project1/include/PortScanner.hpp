@@ -11,6 +11,10 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <set>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include "ShardPlan.hpp"
 
 class PortScanner {
 private:
@@ -21,15 +25,38 @@ private:
     std::vector<int> tcp_ports;
     std::vector<int> udp_ports;
     int timeout_ms = 5000;
+    bool connect_scan = false;
+    bool use_uring = false;
+    bool event_loop = false;
+    bool discover = false;
+    bool show_rtt = false;
+    bool rank_ports = false;
+    bool tx_ring = false;
+    bool grab_banners = false;
+    bool summary_output = false;
+    long long deadline_ms = 0;
+    int tx_bench = 0;
+    bool sharded = false;
+    ShardSpec shard;
+    int min_probes = 1;
+    int max_probes = 4;
+    std::string replay_file;
+    std::string replay_source;
+    std::string baseline_file;
+    double sample_fraction = 0.1;
+    std::string db_file;
+    std::string pcap_file;
+    std::string daemon_socket;
 
 public:
     void parse_arguments(int argc, char* argv[]);
     void get_source_ip();
     void run();
 
+    static std::string get_ip_from_iface(const std::string &iface, bool ipv6);
+    static std::vector<int> parse_ports(const std::string &port_range);
+    static std::vector<std::string> resolve_hostname(const std::string &hostname);
+
 private:
     void list_interfaces() const;
-    std::string get_ip_from_iface(const std::string &iface, bool ipv6) const;
-    std::vector<int> parse_ports(const std::string &port_range) const;
-    std::vector<std::string> resolve_hostname(const std::string &hostname) const;
 };
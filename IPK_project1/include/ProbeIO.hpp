@@ -0,0 +1,202 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <ctime>
+#include <linux/io_uring.h>
+#include "NextHop.hpp"
+
+/**
+ * @brief Send/receive backend used by the probe loops on a raw socket.
+ *
+ * The socket itself is owned by the caller; the backend only moves packets.
+ */
+class ProbeIO {
+public:
+    virtual ~ProbeIO() = default;
+
+    /**
+     * @brief Queues one packet for transmission to the scanned host.
+     * @return true If the packet was handed to the kernel.
+     */
+    virtual bool send(const void *pkt, size_t len) = 0;
+
+    /**
+     * @brief Hands packets queued by send() to the kernel. Backends that send at once do nothing.
+     */
+    virtual void flush() {}
+
+    /**
+     * @brief Receives one packet from the socket.
+     * @param timeout_ms Maximum wait; 0 only checks for an already received packet.
+     * @param stamp If not null, set to the receive time of the packet (CLOCK_REALTIME).
+     * @return ssize_t Number of bytes received, -1 on timeout or error.
+     */
+    virtual ssize_t recv(void *buf, size_t len, int timeout_ms, timespec *stamp) = 0;
+
+    /**
+     * @brief Descriptor that polls readable when recv() may have a packet.
+     */
+    virtual int poll_fd() const = 0;
+
+    /**
+     * @brief Short backend name for diagnostics.
+     */
+    virtual const char *name() const = 0;
+};
+
+/**
+ * @brief Plain sendto()/recvfrom() backend. Works everywhere.
+ */
+class SocketIO : public ProbeIO {
+private:
+    int sock;
+    sockaddr_storage dst;
+    socklen_t dst_len;
+    int rcv_timeout_ms = -1;
+
+public:
+    SocketIO(int sock, const sockaddr *dst, socklen_t dst_len);
+    bool send(const void *pkt, size_t len) override;
+    ssize_t recv(void *buf, size_t len, int timeout_ms, timespec *stamp) override;
+    int poll_fd() const override { return sock; }
+    const char *name() const override { return "sendto"; }
+};
+
+/**
+ * @brief io_uring backend: fixed-buffer writes and a multishot receive on one ring.
+ *
+ * The ring runs with a kernel submission thread (SQPOLL) when possible, so queued sends need
+ * no system call. Completions already posted are reaped through shared memory; waiting for
+ * one still enters the kernel.
+ */
+class UringIO : public ProbeIO {
+private:
+    static const unsigned RING_ENTRIES = 256;
+    static const unsigned SEND_SLOTS = 128;
+    static const unsigned RECV_BUFS = 128;
+    static const unsigned SLOT_SIZE = 2048;
+
+    int sock;
+    bool receive;
+    int ring_fd = -1;
+    bool sqpoll = false;
+
+    void *sq_map = nullptr;
+    size_t sq_map_len = 0;
+    void *cq_map = nullptr;
+    size_t cq_map_len = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqes_len = 0;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail = 0;
+
+    uint8_t *send_region = nullptr;
+    bool send_busy[SEND_SLOTS] = {};
+    unsigned next_slot = 0;
+
+    uint8_t *recv_region = nullptr;
+    struct io_uring_buf_ring *buf_ring = nullptr;
+    size_t buf_ring_len = 0;
+    uint16_t buf_ring_tail = 0;
+    bool recv_armed = false;
+    int recv_error = 0;
+    bool nop_done = true;
+
+    // Completed receives waiting to be consumed: buffer id, length and reap time.
+    uint16_t ready_bid[RECV_BUFS];
+    int32_t ready_len[RECV_BUFS];
+    timespec ready_stamp[RECV_BUFS];
+    unsigned ready_head = 0, ready_tail = 0;
+
+    UringIO(int sock, bool receive);
+    bool setup(bool want_sqpoll);
+    struct io_uring_sqe *get_sqe();
+    void submit();
+    void reap();
+    bool wait_cqe(int timeout_ms);
+    void arm_recv();
+    void recycle(uint16_t bid);
+
+public:
+    ~UringIO() override;
+
+    /**
+     * @brief Creates the backend for a connected socket.
+     * @return std::unique_ptr<UringIO> nullptr if the kernel lacks the needed io_uring features.
+     */
+    static std::unique_ptr<UringIO> create(int sock, bool receive);
+
+    bool send(const void *pkt, size_t len) override;
+    void flush() override;
+    ssize_t recv(void *buf, size_t len, int timeout_ms, timespec *stamp) override;
+    int poll_fd() const override { return ring_fd; }
+    const char *name() const override { return sqpoll ? "io_uring (sqpoll)" : "io_uring"; }
+};
+
+/**
+ * @brief Link-layer backend: prebuilt Ethernet frames in an AF_PACKET PACKET_TX_RING.
+ *
+ * send() copies the IP packet behind a fixed Ethernet header into the next ring slot; the
+ * kernel gets the queued frames with one send() per batch (or at flush() and before any
+ * receive, so one frame per send() in the stop-and-wait scan), bypassing routing and
+ * neighbour lookup for every packet. Receiving is left to the wrapped backend.
+ */
+class PacketRingIO : public ProbeIO {
+private:
+    static const unsigned FRAME_SIZE = 2048;
+    static const unsigned FRAME_COUNT = 256;
+    static const unsigned BATCH = 64;
+
+    std::unique_ptr<ProbeIO> inner;
+    int fd = -1;
+    uint8_t *ring = nullptr;
+    size_t ring_len = 0;
+    uint8_t eth_header[14];
+    unsigned next_frame = 0;
+    unsigned pending = 0;
+    unsigned rejected = 0;
+
+    explicit PacketRingIO(std::unique_ptr<ProbeIO> inner);
+
+public:
+    ~PacketRingIO() override;
+
+    /**
+     * @brief Creates the ring on the target's interface.
+     *
+     * @param link Interface index and MAC addresses of the frames.
+     * @param ethertype ETH_P_IP or ETH_P_IPV6.
+     * @param inner Backend that keeps receiving replies.
+     * @return std::unique_ptr<PacketRingIO> nullptr if the ring cannot be set up.
+     */
+    static std::unique_ptr<PacketRingIO> create(const LinkTarget &link, uint16_t ethertype,
+                                                std::unique_ptr<ProbeIO> &inner);
+
+    bool send(const void *pkt, size_t len) override;
+    void flush() override;
+    ssize_t recv(void *buf, size_t len, int timeout_ms, timespec *stamp) override;
+    int poll_fd() const override { return inner->poll_fd(); }
+    const char *name() const override { return "packet_tx_ring"; }
+};
+
+/**
+ * @brief Selects the probe backend for a raw socket.
+ *
+ * @param sock Raw socket used for probing.
+ * @param dst Address of the scanned host.
+ * @param dst_len Length of the address.
+ * @param receive True if replies are read from the same socket.
+ * @param use_uring Try io_uring first and fall back to sendto()/recvfrom() when unsupported.
+ * @return std::unique_ptr<ProbeIO> The selected backend.
+ */
+std::unique_ptr<ProbeIO> make_probe_io(int sock, const sockaddr *dst, socklen_t dst_len,
+                                       bool receive, bool use_uring);
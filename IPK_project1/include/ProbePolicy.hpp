@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include "Timing.hpp"
+#include "RetryBudget.hpp"
+#include "DeadlinePlan.hpp"
+
+class ProbePolicy {
+private:
+    using clock = std::chrono::steady_clock;
+
+    RttEstimator rtt;
+    RetryBudget budget;
+    DeadlinePlan window;
+    int timeout_ms;
+    bool adaptive_wait;
+    int wait = 0;
+    clock::time_point began;
+
+public:
+    ProbePolicy(int timeout_ms, bool adaptive_wait, int initial_probes, int min_probes, int max_probes,
+                clock::time_point deadline, size_t ports);
+    bool next_port(int &limit);
+    int wait_ms() const;
+    void sample(const timespec &sent, const timespec &received) { rtt.sample(sent, received); }
+    void finish_port(int sent, bool answered);
+    void print(const std::string &ip, const char *proto, bool show_rtt) const;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <pcap.h>
+
+/**
+ * @brief Offline replay of a saved capture through the live reply classifiers.
+ *
+ * TCP SYNs and UDP datagrams sent by the scanner are taken as probes; every other frame is
+ * run through the same TCP and ICMP classifiers the scanners use. The scanner's address is
+ * given explicitly or taken, per address family, from the first unicast SYN or UDP datagram. Frames are processed as fast
+ * as they can be read, so the replay doubles as a regression test and a classifier benchmark.
+ */
+class ReplayClassifier {
+private:
+    struct ProbeKey {
+        uint8_t addr[16];
+        uint16_t src_port;
+        uint16_t dst_port;
+        uint16_t proto;
+
+        bool operator==(const ProbeKey &o) const {
+            return std::memcmp(this, &o, sizeof(ProbeKey)) == 0;
+        }
+    };
+
+    struct ProbeKeyHash {
+        size_t operator()(const ProbeKey &k) const;
+    };
+
+    struct Probe {
+        std::string ip;
+        int port;
+        bool decided = false;
+    };
+
+    std::string path;
+    bool have_source[2] = {false, false};
+    uint8_t source_addr[2][16] = {};
+    std::unordered_map<ProbeKey, Probe, ProbeKeyHash> probes;
+    std::vector<ProbeKey> order;
+    uint64_t frames = 0;
+    uint64_t probe_frames = 0;
+    uint64_t unmatched = 0;
+
+public:
+    /**
+     * @param file Capture to replay.
+     * @param source Scanner address (IPv4 or IPv6), or "" to take it from the first probe.
+     */
+    ReplayClassifier(const std::string &file, const std::string &source);
+
+    /**
+     * @brief Replays the capture, reports the decided port states and prints replay statistics.
+     * @return true If the capture could be read.
+     */
+    bool run();
+
+private:
+    template <class AF>
+    void process(const uint8_t *pkt, size_t len);
+
+    template <class AF>
+    static ProbeKey make_key(const typename AF::addr_type &addr, uint16_t src_port,
+                             uint16_t dst_port, uint8_t proto);
+
+    template <class AF>
+    bool from_scanner(const typename AF::addr_type &src, const typename AF::addr_type &dst);
+
+    void note_unmatched(const char *why);
+};
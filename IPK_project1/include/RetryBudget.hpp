@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+class RetryBudget {
+private:
+    static constexpr double TARGET_MISS = 0.01;
+    static constexpr int EXPLORE_EVERY = 16;
+    static constexpr double MIN_YIELD = 0.01;
+    static constexpr double MIN_EVIDENCE = 8;
+    static constexpr double MAX_EVIDENCE = 256;
+
+    int min_probes;
+    int max_probes;
+    int budget;
+    int explore_tick = 0;
+    int weight = 1;
+    double first = 0;
+    double late = 0;
+    double retries = 0;
+    uint64_t ports = 0;
+    uint64_t probes = 0;
+
+    void replan();
+
+public:
+    RetryBudget(int initial, int min_count, int max_count);
+    int next_limit();
+    void record(int answered_on, int sent);
+    int current() const { return budget; }
+    void print(const std::string &ip, const char *proto) const;
+};
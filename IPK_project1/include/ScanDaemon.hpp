@@ -0,0 +1,93 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * @brief Long-running scan service on a Unix domain socket.
+ *
+ * Clients send jobs as frames: a 4-byte big-endian length followed by the job text, which uses
+ * the scanner's own options (`-t ports`, `-u ports`, `--top-ports n`, `--top-udp-ports n`,
+ * `--rank-order`, `-w ms`, `-c`, `-i iface`, target). Every
+ * reply is a frame of the same kind: `<id> accepted`, one `<id> <ip> <port> <proto> <state>` per
+ * result as soon as it is decided, and finally `<id> done` (or `<id> error <reason>`). Several
+ * jobs may be in flight on one connection.
+ *
+ * Jobs are cut into tasks of at most TASK_PORTS ports for one address and protocol. A fixed pool
+ * of workers takes tasks from the active jobs in turn, so a large job cannot starve small ones.
+ * Each worker keeps its raw sockets and captures open between tasks, and interface addresses
+ * are looked up once.
+ */
+class ScanDaemon {
+private:
+    static const size_t TASK_PORTS = 256;
+    static const uint32_t MAX_FRAME = 64 * 1024;
+
+    struct Client {
+        int fd;
+        std::mutex write_mutex;
+        std::atomic<bool> alive{true};
+        std::atomic<bool> reading{true};
+
+        explicit Client(int fd) : fd(fd) {}
+        ~Client();
+        bool send_frame(const std::string &payload);
+    };
+
+    struct Task {
+        std::string ip;
+        std::string src;
+        bool udp;
+        std::vector<int> ports;
+    };
+
+    struct Job {
+        uint64_t id;
+        std::shared_ptr<Client> client;
+        std::string iface;
+        int timeout_ms;
+        bool connect_scan;
+        std::vector<Task> tasks;
+        size_t next_task = 0;
+        std::atomic<size_t> remaining{0};
+    };
+
+    std::string path;
+    std::string default_iface;
+    int default_timeout_ms;
+    unsigned worker_count;
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::deque<std::shared_ptr<Job>> ready;
+    std::map<std::string, std::pair<std::string, std::string>> iface_addrs;
+    std::atomic<uint64_t> next_id{1};
+    bool stopping = false;
+
+public:
+    /**
+     * @param socket_path Path of the listening socket (a stale socket there is replaced).
+     * @param iface Interface used by jobs that do not name one.
+     * @param timeout_ms Timeout used by jobs that do not set `-w`.
+     */
+    ScanDaemon(const std::string &socket_path, const std::string &iface, int timeout_ms);
+
+    /**
+     * @brief Listens and serves clients until the process is stopped.
+     * @return false If the socket could not be set up or accepting failed.
+     */
+    bool serve();
+
+private:
+    void client_loop(std::shared_ptr<Client> client);
+    void worker_loop();
+    void run_task(Job &job, const Task &task, class SocketCache &cache);
+    std::shared_ptr<Job> parse_job(const std::string &text, std::shared_ptr<Client> client, std::string &error);
+    std::pair<std::string, std::string> interface_addresses(const std::string &iface);
+};
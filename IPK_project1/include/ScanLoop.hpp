@@ -0,0 +1,336 @@
+#pragma once
+#include <coroutine>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include "SocketCache.hpp"
+#include "AddressFamily.hpp"
+
+class ScanLoop;
+class SendProbe;
+
+/**
+ * @brief Coroutine of one scan job (one protocol against one address), run by a ScanLoop.
+ *
+ * The coroutine starts suspended and is handed to ScanLoop::spawn(), which owns it from then
+ * on; its frame is freed when the body returns.
+ */
+class ScanTask {
+public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    /**
+     * @brief Frees the finished coroutine and tells its loop that a task slot is free.
+     */
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(handle_type h) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type {
+        ScanLoop *loop = nullptr;
+        ScanTask get_return_object() { return ScanTask(handle_type::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void return_void() const {}
+        void unhandled_exception() const { std::terminate(); }
+    };
+
+    ScanTask(ScanTask &&other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    ScanTask(const ScanTask &) = delete;
+    ScanTask &operator=(const ScanTask &) = delete;
+    ~ScanTask() { if (handle) handle.destroy(); }
+
+private:
+    friend class ScanLoop;
+    handle_type handle;
+
+    explicit ScanTask(handle_type h) : handle(h) {}
+};
+
+/**
+ * @brief Identifies the probe a received packet answers: address family, transport protocol,
+ *        target address and port, and our source port.
+ */
+struct ReplyKey {
+    uint8_t family = 0;
+    uint8_t proto = 0;
+    uint16_t remote_port = 0;
+    uint16_t local_port = 0;
+    uint8_t addr[16] = {};
+
+    bool operator==(const ReplyKey &other) const {
+        return family == other.family && proto == other.proto && remote_port == other.remote_port &&
+               local_port == other.local_port && memcmp(addr, other.addr, sizeof(addr)) == 0;
+    }
+};
+
+struct ReplyKeyHash {
+    size_t operator()(const ReplyKey &key) const;
+};
+
+/**
+ * @brief A suspended task waiting in a ScanLoop for a reply, a timeout or both.
+ *
+ * The loop resumes the task when offer() accepts a packet delivered under the key, or when
+ * the timer expires; `answered` tells which.
+ */
+class PendingWait {
+public:
+    ReplyKey key;
+    bool keyed = false;
+    bool answered = false;
+    timespec stamp{};
+    std::coroutine_handle<> handle;
+    std::multimap<std::chrono::steady_clock::time_point, PendingWait*>::iterator timer;
+
+    virtual ~PendingWait() = default;
+
+    /**
+     * @brief Classifies a packet carrying this wait's key.
+     *
+     * @param pkt Packet starting at the IP/IPv6 header.
+     * @return true If the packet ends the wait.
+     */
+    virtual bool offer(const uint8_t *, size_t) { return false; }
+};
+
+/**
+ * @brief Single-threaded event loop running scan jobs as coroutines.
+ *
+ * The loop owns one set of probe sockets and captures for all jobs and waits on them with
+ * epoll. A task suspends while it waits for a reply or for send buffer space; the loop demultiplexes every
+ * received packet by target address and ports to the task expecting it, and resumes tasks
+ * whose timeout has expired. Up to MAX_RUNNING tasks are in progress at once, so thousands of
+ * targets are scanned concurrently on one thread.
+ */
+class ScanLoop {
+public:
+    static const size_t MAX_RUNNING = 16384;
+
+private:
+    struct Source {
+        int fd;
+        int family = 0;
+        PacketSource *capture = nullptr;
+        bool receives = false;
+        uint32_t events = 0;
+        std::vector<PendingWait*> blocked;
+    };
+
+    std::string iface;
+    SocketCache sockets;
+    in_addr src4{};
+    in6_addr src6{};
+    int epfd = -1;
+    std::vector<Source> sources;
+    int tcp_send[2] = {-1, -1};
+    int udp_send[2] = {-1, -1};
+    uint16_t udp_port[2] = {0, 0};
+    bool tcp_failed[2] = {false, false};
+    bool udp_failed[2] = {false, false};
+
+    std::unordered_map<ReplyKey, PendingWait*, ReplyKeyHash> waiting;
+    std::multimap<std::chrono::steady_clock::time_point, PendingWait*> timers;
+    std::deque<ScanTask::handle_type> queued;
+    size_t running = 0;
+
+    size_t track(int fd);
+    void update(size_t index);
+    void watch(int fd, int family, PacketSource *capture);
+    void drain(size_t index);
+    void release(size_t index);
+    void dispatch(const uint8_t *pkt, size_t len, int family, const timespec &stamp);
+    int next_timeout() const;
+    void expire();
+
+public:
+    /**
+     * @brief Creates the loop; sockets are opened by the first task of each kind.
+     *
+     * @param interface Interface for the IPv6 TCP capture.
+     * @param src Local IPv4 address ("" if none).
+     * @param src6 Local IPv6 address ("" if none).
+     */
+    ScanLoop(const std::string &interface, const std::string &src, const std::string &src6);
+    ~ScanLoop();
+    ScanLoop(const ScanLoop &) = delete;
+    ScanLoop &operator=(const ScanLoop &) = delete;
+
+    /**
+     * @brief Opens the raw TCP probe socket and reply source of a family.
+     * @return true If TCP tasks of that family can run in the loop.
+     */
+    bool open_tcp(int family);
+
+    /**
+     * @brief Opens the UDP probe socket and ICMP socket of a family.
+     * @return true If UDP tasks of that family can run in the loop.
+     */
+    bool open_udp(int family);
+
+    /**
+     * @brief Queues a task; it starts as soon as fewer than MAX_RUNNING tasks are in progress.
+     */
+    void spawn(ScanTask task);
+
+    /**
+     * @brief Runs until every spawned task has finished.
+     */
+    void run();
+
+    /**
+     * @brief Awaitable send of a complete IP/IPv6 TCP packet through the raw socket of its family.
+     *
+     * Resumes with true once sent; with false, without sending, after the socket buffer was
+     * full and has drained, so the caller retries.
+     */
+    SendProbe send_tcp(int family, const void *pkt, size_t len, const sockaddr_storage &dst, socklen_t dst_len);
+
+    /**
+     * @brief Awaitable send of an empty UDP datagram to a port, resuming as send_tcp().
+     */
+    SendProbe send_udp(const sockaddr_storage &dst, socklen_t dst_len);
+
+    /**
+     * @brief Sends a packet if the socket buffer has room.
+     * @return true If the kernel took the packet or dropped it for another reason than a full buffer.
+     */
+    bool try_send(int fd, const void *pkt, size_t len, const sockaddr_storage &dst, socklen_t dst_len);
+
+    /**
+     * @brief Suspends a task until a send socket has room again.
+     */
+    void wait_writable(PendingWait &pending, std::coroutine_handle<> h, int fd);
+
+    /**
+     * @brief Local port of the UDP probe socket of a family, bound when the socket is opened.
+     */
+    uint16_t udp_source_port(int family) const { return udp_port[family == AF_INET6]; }
+
+    /**
+     * @brief Registers a suspended wait, under its key if it has one, with a timeout.
+     */
+    void wait(PendingWait &pending, std::coroutine_handle<> h, int timeout_ms);
+
+    /**
+     * @brief Called by a finishing task.
+     */
+    void finished() { running--; }
+};
+
+/**
+ * @brief Builds the key under which replies from a target port to a local port arrive.
+ */
+template <class AF>
+ReplyKey reply_key(uint8_t proto, const typename AF::addr_type &target, uint16_t remote_port, uint16_t local_port) {
+    ReplyKey key;
+    key.family = AF::family == AF_INET6 ? 6 : 4;
+    key.proto = proto;
+    key.remote_port = remote_port;
+    key.local_port = local_port;
+    memcpy(key.addr, &target, sizeof(target));
+    return key;
+}
+
+/**
+ * @brief Awaitable probe send returned by ScanLoop::send_tcp() and send_udp().
+ *
+ * The packet goes out at once when the socket buffer has room, without suspending.
+ */
+class SendProbe : public PendingWait {
+private:
+    ScanLoop &loop;
+    int fd;
+    const void *pkt;
+    size_t len;
+    const sockaddr_storage &dst;
+    socklen_t dst_len;
+    bool sent = false;
+
+public:
+    SendProbe(ScanLoop &l, int sock, const void *packet, size_t length, const sockaddr_storage &to, socklen_t to_len)
+        : loop(l), fd(sock), pkt(packet), len(length), dst(to), dst_len(to_len) {}
+
+    bool await_ready() { return sent = loop.try_send(fd, pkt, len, dst, dst_len); }
+    void await_suspend(std::coroutine_handle<> h) { loop.wait_writable(*this, h, fd); }
+    bool await_resume() const { return sent; }
+};
+
+/**
+ * @brief Awaitable wait for the SYN-ACK, RST or ICMP error answering one SYN.
+ *
+ * Resumes with the classification, or TcpReply::None once the timeout expires.
+ */
+template <class AF>
+class TcpReplyWait : public PendingWait {
+private:
+    ScanLoop &loop;
+    typename AF::addr_type dst;
+    uint16_t src_port, dst_port;
+    int timeout_ms;
+    TcpReply reply = TcpReply::None;
+
+public:
+    TcpReplyWait(ScanLoop &l, const typename AF::addr_type &target, uint16_t sport, uint16_t dport, int timeout)
+        : loop(l), dst(target), src_port(sport), dst_port(dport), timeout_ms(timeout) {
+        key = reply_key<AF>(IPPROTO_TCP, dst, dst_port, src_port);
+        keyed = true;
+    }
+
+    bool offer(const uint8_t *pkt, size_t len) override {
+        reply = classify_tcp_reply<AF>(pkt, len, dst, src_port, dst_port);
+        return reply != TcpReply::None;
+    }
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { loop.wait(*this, h, timeout_ms); }
+    TcpReply await_resume() const { return reply; }
+};
+
+/**
+ * @brief Awaitable wait for the ICMP/ICMPv6 Port Unreachable answering one UDP datagram.
+ *
+ * Resumes with true if the port is closed, false once the timeout expires.
+ */
+template <class AF>
+class UdpUnreachableWait : public PendingWait {
+private:
+    ScanLoop &loop;
+    typename AF::addr_type dst;
+    uint16_t dst_port;
+    int timeout_ms;
+
+public:
+    UdpUnreachableWait(ScanLoop &l, const typename AF::addr_type &target, uint16_t dport, int timeout)
+        : loop(l), dst(target), dst_port(dport), timeout_ms(timeout) {
+        key = reply_key<AF>(IPPROTO_UDP, dst, dst_port, loop.udp_source_port(AF::family));
+        keyed = true;
+    }
+
+    bool offer(const uint8_t *pkt, size_t len) override {
+        uint8_t proto;
+        typename AF::addr_type from, to;
+        size_t l4_len;
+        const uint8_t *l4 = AF::transport(pkt, len, proto, from, to, l4_len);
+        IcmpError err;
+        if (!l4 || proto != AF::icmp_protocol || !AF::parse_icmp_error(l4, l4_len, IPPROTO_UDP, dst, err))
+            return false;
+        const struct udphdr *udph = reinterpret_cast<const struct udphdr*>(err.quote);
+        return ntohs(udph->dest) == dst_port && err.type == AF::unreach_type && err.code == AF::port_unreach_code;
+    }
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { loop.wait(*this, h, timeout_ms); }
+    bool await_resume() const { return answered; }
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <iostream>
+#include "Baseline.hpp"
+#include "StateDb.hpp"
+
+class BannerGrabber;
+class ScanSummary;
+
+/**
+ * @brief Receives the result lines of the scans running on one thread.
+ */
+class ReportSink {
+public:
+    virtual ~ReportSink() = default;
+
+    /**
+     * @brief Takes one result in the common output format, without the newline.
+     */
+    virtual void report(const std::string &line) = 0;
+};
+
+/**
+ * @brief Prints the state of a single scanned port in the common output format.
+ *
+ * Every scan mode reports through this function so the output stays
+ * `<ip> <port> <tcp|udp> <open|closed|filtered>` regardless of how the state was obtained.
+ * With a baseline set, unchanged results are dropped and changes are printed as
+ * `<ip> <port> <proto> <old> -> <new>`.
+ * With a database set, results are stored there instead of being printed.
+ * On a thread with a report sink, results go only to that sink.
+ * With a banner stage set, open TCP ports in line output are printed by that stage instead.
+ * With a summary set, closed and filtered ports in line output are only counted there.
+ *
+ * @param ip Target IP address.
+ * @param port Scanned port.
+ * @param proto Protocol name ("tcp" or "udp").
+ * @param state Port state ("open", "closed" or "filtered").
+ */
+void report_port(const std::string &ip, int port, const char *proto, const char *state);
+
+/**
+ * @brief Prints an open TCP port together with the banner read from it.
+ *
+ * The line is `<ip> <port> tcp open <banner>`, or the plain open line if the banner is empty.
+ */
+void report_open_banner(const std::string &ip, int port, const std::string &banner);
+
+/**
+ * @brief Switches report_port() to diff output against a previous scan.
+ *
+ * @param baseline Baseline updated with every result, or nullptr for plain output.
+ */
+void set_report_baseline(Baseline *baseline);
+
+/**
+ * @brief Sends results to a port-state database instead of stdout.
+ *
+ * @param db Open database, or nullptr for line output.
+ */
+void set_report_database(StateDb *db);
+
+/**
+ * @brief Routes the results reported on the calling thread to a sink.
+ *
+ * @param sink Sink for this thread, or nullptr to restore the global output.
+ */
+void set_thread_report_sink(ReportSink *sink);
+
+/**
+ * @brief Hands open TCP ports in line output to a banner-grabbing stage.
+ *
+ * @param grabber Running stage, or nullptr to print open ports directly.
+ */
+void set_report_banners(BannerGrabber *grabber);
+
+/**
+ * @brief Collects closed and filtered results in a summary instead of printing them.
+ *
+ * @param summary Summary printed by the caller when the scan ends, or nullptr for full output.
+ */
+void set_report_summary(ScanSummary *summary);
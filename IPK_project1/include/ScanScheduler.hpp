@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Runs independent scan jobs concurrently.
+ *
+ * Each job (one protocol against one address) owns its sockets and capture; the scheduler
+ * only starts them together and waits until all have finished. Results reach the common
+ * output through report_port(), which serializes whole lines.
+ */
+class ScanScheduler {
+private:
+    std::vector<std::function<void()>> jobs;
+
+public:
+    /**
+     * @brief Queues a job to be started by run().
+     */
+    void add(std::function<void()> job);
+
+    /**
+     * @brief Starts all queued jobs at once and blocks until every one has returned.
+     */
+    void run();
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <cstdint>
+#include <iostream>
+#include "Baseline.hpp"
+
+/**
+ * @brief Per-host aggregation of results for the summary output mode.
+ *
+ * Open ports are still printed as they are found; closed and filtered ports are only counted
+ * here and printed at the end as compressed runs (`<ip> <proto> closed 1-21,23-79`) followed
+ * by a count line per host and protocol.
+ */
+class ScanSummary {
+private:
+    std::mutex mutex;
+    // (ip, proto) -> state of every port, indexed by port number.
+    std::map<std::pair<std::string, std::string>, std::vector<uint8_t>> hosts;
+
+public:
+    /**
+     * @brief Records one result. Safe to call from concurrent scans.
+     */
+    void record(const std::string &ip, int port, const char *proto, const char *state);
+
+    /**
+     * @brief Prints the closed and filtered runs and the counts of every host and protocol.
+     */
+    void print(std::ostream &out);
+};
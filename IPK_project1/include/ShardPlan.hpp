@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <functional>
+
+class ShardPermutation {
+private:
+    static const int ROUNDS = 4;
+
+    uint64_t size;
+    int half_bits;
+    uint64_t half_mask;
+    uint64_t keys[ROUNDS];
+
+    uint64_t encrypt(uint64_t value) const;
+
+public:
+    ShardPermutation(uint64_t size, uint64_t seed);
+    uint64_t at(uint64_t index) const;
+};
+
+struct ShardSpec {
+    unsigned index = 0;
+    unsigned count = 1;
+    uint64_t seed = 0;
+
+    bool parse(const std::string &spec);
+    void walk(uint64_t size, const std::function<void(uint64_t)> &visit) const;
+};
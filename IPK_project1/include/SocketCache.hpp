@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <map>
+#include <memory>
+#include <netinet/in.h>
+#include "PacketSource.hpp"
+
+/**
+ * @brief Probe sockets and captures kept open across scans run by one thread.
+ *
+ * Without a cache every scan opens and closes its own raw sockets and pcap handle. The
+ * daemon gives each worker a cache so that consecutive jobs reuse them. Scans sharing a
+ * socket must run one after another; stale replies left in a socket are ignored by the
+ * classifiers, which match addresses and ports.
+ */
+class SocketCache {
+private:
+    int tcp4 = -1;
+    std::map<std::string, int> tcp6;
+    std::map<std::string, std::unique_ptr<PcapSource>> captures6;
+    int udp[2] = {-1, -1};
+    int icmp[2] = {-1, -1};
+
+public:
+    SocketCache() = default;
+    SocketCache(const SocketCache &) = delete;
+    SocketCache &operator=(const SocketCache &) = delete;
+    ~SocketCache();
+
+    /**
+     * @brief Raw TCP probe socket for IPv4 (same return values as open_raw_socket()).
+     */
+    int tcp_socket(const in_addr &src);
+
+    /**
+     * @brief Raw probe socket for IPv6, one per source address.
+     */
+    int tcp_socket(const in6_addr &src);
+
+    /**
+     * @brief Capture of all IPv6 TCP and ICMPv6 traffic on an interface.
+     * @return PacketSource* nullptr if the capture cannot be opened.
+     */
+    PacketSource *tcp6_capture(const std::string &iface);
+
+    /**
+     * @brief Unconnected UDP socket for sending probes.
+     */
+    int udp_socket(int family);
+
+    /**
+     * @brief Raw ICMP/ICMPv6 socket for receiving unreachable errors.
+     */
+    int icmp_socket(int family);
+};
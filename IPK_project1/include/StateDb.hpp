@@ -0,0 +1,98 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief Fixed header at the start of a port-state database file.
+ */
+struct StateDbHeader {
+    char magic[8];          // "IPKSDB1\0"
+    uint32_t version;
+    uint32_t host_count;
+    uint64_t data_offset;   // Page-aligned start of the per-host state arrays
+};
+
+/**
+ * @brief Index entry for one host; entry i owns the i-th block of state arrays.
+ */
+struct StateDbHost {
+    uint8_t addr[16];       // in_addr or in6_addr, network order
+    uint8_t family;         // 4 or 6
+    uint8_t reserved[7];
+};
+
+/**
+ * @brief Memory-mapped port-state database: 2 bits per port, per protocol, per host.
+ *
+ * The file is a StateDbHeader, a StateDbHost index and, from data_offset, one block per host
+ * holding a 16 KiB TCP array followed by a 16 KiB UDP array. Port p lives in byte p / 4 at bit
+ * offset (p % 4) * 2. The whole file is sized when it is created, so recording a result is a
+ * store into the mapping and reading one needs neither copying nor parsing.
+ */
+class StateDb {
+public:
+    enum State : uint8_t { UNSCANNED = 0, OPEN, CLOSED, FILTERED };
+    enum Proto : uint8_t { TCP = 0, UDP = 1 };
+
+    static const size_t PORTS = 65536;
+    static const size_t ARRAY_BYTES = PORTS / 4;
+    static const size_t HOST_BYTES = 2 * ARRAY_BYTES;
+
+private:
+    int fd = -1;
+    uint8_t *base = nullptr;
+    size_t length = 0;
+    bool writable = false;
+    const StateDbHeader *header = nullptr;
+    const StateDbHost *hosts = nullptr;
+    uint8_t *data = nullptr;
+    std::unordered_map<std::string, uint32_t> by_address;
+
+    StateDb() = default;
+    bool map(int fd, size_t length, bool writable);
+
+public:
+    ~StateDb();
+    StateDb(const StateDb &) = delete;
+    StateDb &operator=(const StateDb &) = delete;
+
+    /**
+     * @brief Creates (or truncates) a database sized for the given hosts.
+     * @return std::unique_ptr<StateDb> nullptr on failure (error already printed).
+     */
+    static std::unique_ptr<StateDb> create(const std::string &path, const std::vector<std::string> &addrs);
+
+    /**
+     * @brief Maps an existing database read-only.
+     * @return std::unique_ptr<StateDb> nullptr on failure (error already printed).
+     */
+    static std::unique_ptr<StateDb> open(const std::string &path);
+
+    /**
+     * @brief Stores a result reported in the common output format.
+     * @return true If the host is part of the database.
+     */
+    bool record(const std::string &ip, int port, const char *proto, const char *state);
+
+    uint32_t host_count() const { return header->host_count; }
+    const StateDbHost &host(uint32_t i) const { return hosts[i]; }
+    std::string host_name(uint32_t i) const;
+
+    /**
+     * @brief Returns the raw 2-bit state array of one host and protocol.
+     */
+    const uint8_t *states(uint32_t i, Proto proto) const {
+        return data + static_cast<size_t>(i) * HOST_BYTES + proto * ARRAY_BYTES;
+    }
+
+    static State get(const uint8_t *states, int port) {
+        return static_cast<State>((states[port >> 2] >> ((port & 3) * 2)) & 3);
+    }
+
+    static const char *name(State s);
+};
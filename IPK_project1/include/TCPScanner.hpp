@@ -12,6 +12,13 @@
 #include <sys/socket.h>
 #include <net/if.h>
 #include <pcap.h>
+#include <chrono>
+#include "ProbeIO.hpp"
+#include "AddressFamily.hpp"
+
+class SocketCache;
+class ScanLoop;
+class ScanTask;
 
 const int BUFFER_SIZE = 1500;
 
@@ -22,8 +29,71 @@ private:
     std::string src_ip;
     std::vector<int> ports;
     int timeout_ms;
+    bool use_uring;
+    bool show_rtt;
+    int min_probes;
+    int max_probes;
+    SocketCache *cache = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    bool tx_ring = false;
 
 public:
-    TCPScanner(const std::string& interface, const std::string& dst, const std::string& src, const std::vector<int>& p, int timeout);
-    void scan();
+    TCPScanner(const std::string& interface, const std::string& dst, const std::string& src, const std::vector<int>& p, int timeout, bool uring = false, bool rtt = false, int min_count = 1, int max_count = 4);
+    bool scan();
+
+    /**
+     * @brief Takes probe sockets and captures from a cache instead of opening them per scan.
+     */
+    void use_cache(SocketCache *c) { cache = c; }
+
+    /**
+     * @brief Fits the scan into a time window, cutting retries, waits and finally the last ports.
+     */
+    void use_deadline(std::chrono::steady_clock::time_point end) { deadline = end; }
+
+    /**
+     * @brief Sends probes as Ethernet frames through a PACKET_TX_RING instead of the raw socket.
+     */
+    void use_tx_ring(bool on) { tx_ring = on; }
+
+    /**
+     * @brief Sends @p count SYNs through the raw socket and then through the PACKET_TX_RING,
+     *        without waiting for replies, and prints the packet rate of each to stderr.
+     * @return true If the benchmark ran, false if the raw socket could not be opened.
+     */
+    bool benchmark(unsigned count);
+
+    /**
+     * @brief Queues the scan as a coroutine on an event loop instead of running it on this thread.
+     *
+     * The scanner must outlive the loop's run(). The loop's own sockets are used; the io_uring
+     * and TX ring backends and socket caches do not apply.
+     * @return false If the loop cannot send raw TCP probes for the target's address family.
+     */
+    bool schedule(ScanLoop &loop);
+
+private:
+    template <class AF>
+    bool scan_family(const typename AF::addr_type &src, const typename AF::addr_type &dst);
+
+    template <class AF>
+    ScanTask scan_coroutine(ScanLoop &loop, typename AF::addr_type src, typename AF::addr_type dst);
+
+    template <class AF>
+    bool benchmark_family(const typename AF::addr_type &src, const typename AF::addr_type &dst, unsigned count);
+
+    template <class AF>
+    std::unique_ptr<ProbeIO> link_layer_io(const typename AF::addr_type &dst, std::unique_ptr<ProbeIO> &io);
 };
+
+/**
+ * @brief Opens the raw IPv4 probe socket (IP_HDRINCL, also receives TCP replies).
+ * @return int Socket descriptor, -1 on failure.
+ */
+int open_raw_socket(const in_addr &src);
+
+/**
+ * @brief Opens the raw IPv6 probe socket (IPV6_HDRINCL) bound to the source address.
+ * @return int Socket descriptor, -1 if the socket cannot be created, -2 if binding failed.
+ */
+int open_raw_socket(const in6_addr &src);
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Current CLOCK_REALTIME time, the clock kernel and pcap receive timestamps use.
+ */
+timespec wall_clock_now();
+
+/**
+ * @brief Difference b - a in nanoseconds.
+ */
+inline int64_t elapsed_ns(const timespec &a, const timespec &b) {
+    return (static_cast<int64_t>(b.tv_sec) - a.tv_sec) * 1000000000LL + (b.tv_nsec - a.tv_nsec);
+}
+
+/**
+ * @brief Asks the kernel to timestamp every packet received on the socket (SO_TIMESTAMPNS).
+ */
+void enable_rx_timestamps(int sock);
+
+/**
+ * @brief Receives one packet together with its kernel receive timestamp.
+ *
+ * @param stamp Set to the SO_TIMESTAMPNS time, or to the current time if the kernel gave none.
+ * @param flags recvmsg() flags, e.g. MSG_DONTWAIT.
+ * @param from If not null, set to the sender address.
+ * @return ssize_t Number of bytes received, -1 on error (as recv()).
+ */
+ssize_t recv_stamped(int sock, void *buf, size_t len, timespec *stamp, int flags = 0,
+                     sockaddr_storage *from = nullptr);
+
+/**
+ * @brief Round-trip time estimator (RFC 6298) driving the per-probe wait of one scan job.
+ *
+ * Until the first sample arrives the wait is the configured maximum (`-w`); afterwards it is
+ * SRTT + 4 * RTTVAR, clamped between a floor and that maximum.
+ */
+class RttEstimator {
+private:
+    static constexpr int MIN_TIMEOUT_MS = 100;
+
+    int max_ms;
+    bool have_sample = false;
+    double srtt = 0;
+    double rttvar = 0;
+    double min_rtt = 0;
+    double max_rtt = 0;
+    double sum_rtt = 0;
+    uint64_t samples = 0;
+
+public:
+    explicit RttEstimator(int max_timeout_ms) : max_ms(max_timeout_ms) {}
+
+    /**
+     * @brief Adds the RTT of an unambiguous probe/reply pair (no retransmission in between).
+     */
+    void sample(const timespec &sent, const timespec &received);
+
+    /**
+     * @brief Current wait for a reply, in milliseconds.
+     */
+    int timeout_ms() const;
+
+    /**
+     * @brief Shortest wait that still covers the measured RTT: the largest sample, at least
+     *        MIN_TIMEOUT_MS and at most timeout_ms().
+     */
+    int floor_ms() const;
+
+    /**
+     * @brief Prints min/avg/max RTT and the final wait to stderr.
+     */
+    void print(const std::string &ip, const char *proto) const;
+};
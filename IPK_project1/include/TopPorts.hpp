@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Returns the n most frequently open ports, most likely first.
+ *
+ * Past the end of the built-in table the remaining ports follow in numeric order, so any n
+ * up to 65535 yields that many distinct ports.
+ *
+ * @param udp True for the UDP table, false for TCP.
+ * @param n Number of ports.
+ */
+std::vector<int> top_ports(bool udp, size_t n);
+
+/**
+ * @brief Reorders a port list so ranked ports come first, by rank; unranked ports keep their order.
+ *
+ * @param ports Ports to reorder in place.
+ * @param udp True to use the UDP ranking, false for TCP.
+ */
+void rank_order(std::vector<int> &ports, bool udp);
@@ -8,6 +8,11 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <pcap.h>
+#include <chrono>
+
+class SocketCache;
+class ScanLoop;
+class ScanTask;
 
 class UDPScanner {
 private:
@@ -15,8 +20,38 @@ private:
     std::string dst_ip;
     std::vector<int> ports;
     int timeout_ms;
+    bool show_rtt;
+    int min_probes;
+    int max_probes;
+    SocketCache *cache = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
 
 public:
-    UDPScanner(const std::string& dst, const std::vector<int>& p, int timeout);
+    UDPScanner(const std::string& dst, const std::vector<int>& p, int timeout, bool rtt = false, int min_count = 1, int max_count = 4);
     void scan();
+
+    /**
+     * @brief Takes the probe and ICMP sockets from a cache instead of opening them per scan.
+     */
+    void use_cache(SocketCache *c) { cache = c; }
+
+    /**
+     * @brief Fits the scan into a time window, cutting retries, waits and finally the last ports.
+     */
+    void use_deadline(std::chrono::steady_clock::time_point end) { deadline = end; }
+
+    /**
+     * @brief Queues the scan as a coroutine on an event loop instead of running it on this thread.
+     *
+     * The scanner must outlive the loop's run().
+     * @return false If the loop cannot open the UDP and ICMP sockets for the target's family.
+     */
+    bool schedule(ScanLoop &loop);
+
+private:
+    template <class AF>
+    void scan_family(const typename AF::addr_type &dst);
+
+    template <class AF>
+    ScanTask scan_coroutine(ScanLoop &loop, typename AF::addr_type dst);
 };
@@ -0,0 +1,238 @@
+#include "BannerGrabber.hpp"
+#include "ConnectScanner.hpp"
+#include "ScanOutput.hpp"
+#include <sys/eventfd.h>
+
+static const uint64_t WAKE_TAG = UINT64_MAX;
+
+/**
+ * @brief Starts the grabbing thread.
+ *
+ * @param max_inflight Maximum number of banner connections open at once.
+ * @param timeout_ms Time allowed for connecting and for the first bytes to arrive.
+ */
+BannerGrabber::BannerGrabber(int max_inflight, int timeout_ms)
+    : max_inflight(max_inflight > 0 ? max_inflight : 1), timeout_ms(timeout_ms) {
+    slots.assign(this->max_inflight, Slot{});
+    for (int i = this->max_inflight - 1; i >= 0; --i) free_slots.push_back(i);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd < 0 || wake_fd < 0) {
+        perror("banner grabber");
+        return;
+    }
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_TAG;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd, &ev);
+    worker = std::thread(&BannerGrabber::run, this);
+}
+
+/**
+ * @brief Finishes outstanding work and releases the descriptors.
+ */
+BannerGrabber::~BannerGrabber() {
+    close();
+    if (wake_fd >= 0) ::close(wake_fd);
+    if (epfd >= 0) ::close(epfd);
+}
+
+/**
+ * @brief Queues an open port and wakes the grabbing thread.
+ *
+ * @param ip Target address.
+ * @param port Open TCP port.
+ */
+void BannerGrabber::submit(const std::string &ip, int port) {
+    if (!worker.joinable()) {
+        report_open_banner(ip, port, "");
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back({ip, port});
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+/**
+ * @brief Lets the thread drain its queue and connections, then joins it.
+ */
+void BannerGrabber::close() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        closing = true;
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {}
+    worker.join();
+}
+
+/**
+ * @brief Keeps only the first line of the received data, with unprintable bytes replaced.
+ *
+ * @param data Received bytes.
+ * @param len Number of bytes.
+ * @param limit Maximum length of the result.
+ * @return std::string The printable banner, possibly empty.
+ */
+static std::string printable_banner(const char *data, size_t len, size_t limit) {
+    std::string banner;
+    for (size_t i = 0; i < len && banner.size() < limit; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '\r' || c == '\n') {
+            if (!banner.empty()) break;
+            continue;
+        }
+        banner += (c >= 0x20 && c < 0x7f) ? static_cast<char>(c) : '.';
+    }
+    while (!banner.empty() && banner.back() == ' ') banner.pop_back();
+    return banner;
+}
+
+/**
+ * @brief Opens a non-blocking connection to one open port.
+ *
+ * @param target Address and port.
+ */
+void BannerGrabber::start(const Pending &target) {
+    sockaddr_storage addr;
+    socklen_t addr_len = make_sockaddr(target.ip, target.port, addr);
+    int fd = addr_len ? socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) : -1;
+    if (fd < 0) {
+        report_open_banner(target.ip, target.port, "");
+        return;
+    }
+    // Abort with RST on close; a banner connection should not leave TIME_WAIT state behind.
+    struct linger lg{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), addr_len) < 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        report_open_banner(target.ip, target.port, "");
+        return;
+    }
+
+    uint32_t idx = free_slots.back();
+    free_slots.pop_back();
+    Slot &s = slots[idx];
+    s.fd = fd;
+    s.ip = target.ip;
+    s.port = target.port;
+    s.connected = false;
+    s.gen++;
+
+    struct epoll_event ev{};
+    ev.events = EPOLLOUT;
+    ev.data.u64 = (static_cast<uint64_t>(s.gen) << 32) | idx;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    deadlines.push({std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms), idx, s.gen});
+    inflight++;
+}
+
+/**
+ * @brief Reports the port with its banner and releases the slot.
+ *
+ * @param slot Slot index.
+ * @param banner Banner text, empty if none was received.
+ */
+void BannerGrabber::finish(uint32_t slot, const std::string &banner) {
+    Slot &s = slots[slot];
+    report_open_banner(s.ip, s.port, banner);
+    ::close(s.fd);
+    s.fd = -1;
+    s.gen++;
+    free_slots.push_back(slot);
+    inflight--;
+}
+
+/**
+ * @brief Computes the epoll_wait() timeout from the earliest live deadline.
+ *
+ * @return int Milliseconds until the nearest deadline, -1 if nothing is pending.
+ */
+int BannerGrabber::next_timeout_ms() {
+    while (!deadlines.empty()) {
+        const Deadline &d = deadlines.top();
+        if (slots[d.slot].gen != d.gen) {
+            deadlines.pop();
+            continue;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            d.when - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<int>(left) + 1 : 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief Event loop of the grabbing thread.
+ *
+ * Queued ports are started while slots are free. A writable socket is checked for a
+ * successful connect and then waited on for data; the first read ends the connection.
+ * Connections past their deadline are reported without a banner.
+ */
+void BannerGrabber::run() {
+    std::vector<struct epoll_event> events(64);
+    char buf[BANNER_BYTES];
+    while (true) {
+        std::vector<Pending> batch;
+        bool drained;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            while (!queue.empty() && batch.size() < free_slots.size()) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            drained = closing && queue.empty();
+        }
+        // Connections are started outside the lock so submit() never waits for them.
+        for (const Pending &target : batch) start(target);
+        if (drained && batch.empty() && inflight == 0) break;
+
+        int n = epoll_wait(epfd, events.data(), static_cast<int>(events.size()), next_timeout_ms());
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == WAKE_TAG) {
+                uint64_t count;
+                if (read(wake_fd, &count, sizeof(count)) < 0) {}
+                continue;
+            }
+            uint32_t idx = static_cast<uint32_t>(events[i].data.u64);
+            uint32_t gen = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            Slot &s = slots[idx];
+            if (s.gen != gen || s.fd < 0) continue;
+            if (!s.connected) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if (getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+                    finish(idx, "");
+                    continue;
+                }
+                s.connected = true;
+                struct epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.u64 = events[i].data.u64;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, s.fd, &ev);
+                continue;
+            }
+            ssize_t got = recv(s.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            finish(idx, got > 0 ? printable_banner(buf, static_cast<size_t>(got), BANNER_SHOWN) : "");
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        while (!deadlines.empty() && deadlines.top().when <= now) {
+            Deadline d = deadlines.top();
+            deadlines.pop();
+            if (slots[d.slot].gen == d.gen && slots[d.slot].fd >= 0)
+                finish(d.slot, "");
+        }
+    }
+    for (Slot &s : slots) {
+        if (s.fd >= 0) ::close(s.fd);
+    }
+}
@@ -0,0 +1,193 @@
+#include "Baseline.hpp"
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+
+static const size_t PORT_COUNT = 65536;
+
+const char *Baseline::name(State s) {
+    switch (s) {
+        case OPEN:     return "open";
+        case CLOSED:   return "closed";
+        case FILTERED: return "filtered";
+        default:       return "unknown";
+    }
+}
+
+Baseline::State Baseline::parse_state(const std::string &s) {
+    if (s == "open") return OPEN;
+    if (s == "closed") return CLOSED;
+    if (s == "filtered") return FILTERED;
+    return UNKNOWN;
+}
+
+/**
+ * @brief Loads a previous result file.
+ *
+ * Lines that are not port results (e.g. "skipped" notes) are ignored. Diff lines
+ * (`<ip> <port> <proto> <old> -> <new>`) are accepted too and contribute the new state.
+ *
+ * @param path Path to the result file.
+ * @return true If the file was read or did not exist yet.
+ */
+bool Baseline::load(const std::string &path) {
+    // A missing file is a first run; stat() sets errno, unlike a failed ifstream.
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0 && errno == ENOENT) return true;
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot read baseline " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string ip, port_str, proto, state, arrow, next;
+        if (!(fields >> ip >> port_str >> proto >> state)) continue;
+        if (fields >> arrow >> next && arrow == "->") state = next;
+        if (proto != "tcp" && proto != "udp") continue;
+        State s = parse_state(state);
+        char *end;
+        long port = std::strtol(port_str.c_str(), &end, 10);
+        if (s == UNKNOWN || *end || port < 0 || port >= static_cast<long>(PORT_COUNT)) continue;
+        std::vector<uint8_t> &states = hosts[{ip, proto}];
+        if (states.empty()) states.assign(PORT_COUNT, UNKNOWN);
+        states[port] = s;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the merged states back in the normal output format.
+ *
+ * The file is replaced atomically so an interrupted scan keeps the previous baseline.
+ *
+ * @param path Path to the result file.
+ * @return true On success.
+ */
+bool Baseline::save(const std::string &path) const {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot write baseline " << tmp << std::endl;
+            return false;
+        }
+        for (const auto &host : hosts) {
+            const std::vector<uint8_t> &states = host.second;
+            for (size_t port = 0; port < PORT_COUNT; port++) {
+                if (states[port] != UNKNOWN)
+                    out << host.first.first << " " << port << " " << host.first.second << " "
+                        << name(static_cast<State>(states[port])) << "\n";
+            }
+        }
+        if (!out.flush()) {
+            std::cerr << "Cannot write baseline " << tmp << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        perror("rename");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Orders and samples the ports to probe for one host and protocol.
+ *
+ * A stable run is a stretch of consecutive requested ports that all had the same closed or
+ * filtered state.
+ * Each run is probed at an evenly spaced subset starting from a random offset, so repeated
+ * rescans rotate through the whole run over time.
+ *
+ * @param ip Target address.
+ * @param proto "tcp" or "udp".
+ * @param ports Requested ports.
+ * @param fraction Share of each stable run to probe (at least one port per run).
+ * @return std::vector<int> Previously open ports, then unknown ports, then the sampled runs,
+ *         each group in the order of @p ports.
+ */
+std::vector<int> Baseline::plan(const std::string &ip, const char *proto, const std::vector<int> &ports,
+                                double fraction) const {
+    auto it = hosts.find({ip, proto});
+    if (it == hosts.end()) return ports;
+    const std::vector<uint8_t> &states = it->second;
+
+    auto state_of = [&](int port) {
+        return (port >= 0 && port < static_cast<int>(PORT_COUNT)) ? states[port] : static_cast<uint8_t>(UNKNOWN);
+    };
+
+    // Runs are found on the numerically sorted ports so the requested order does not matter.
+    std::vector<int> stable;
+    for (int port : ports) {
+        uint8_t s = state_of(port);
+        if (s == CLOSED || s == FILTERED) stable.push_back(port);
+    }
+    std::sort(stable.begin(), stable.end());
+
+    std::vector<bool> chosen(PORT_COUNT, false);
+    std::vector<int> run;
+    std::mt19937 rng(std::random_device{}());
+
+    auto flush_run = [&]() {
+        if (run.empty()) return;
+        size_t step = fraction > 0 ? static_cast<size_t>(std::ceil(1.0 / fraction)) : run.size();
+        if (step == 0) step = 1;
+        size_t offset = std::uniform_int_distribution<size_t>(0, std::min(step, run.size()) - 1)(rng);
+        for (size_t i = offset; i < run.size(); i += step)
+            chosen[run[i]] = true;
+        run.clear();
+    };
+
+    uint8_t run_state = UNKNOWN;
+    int prev = -2;
+    for (int port : stable) {
+        uint8_t s = state_of(port);
+        if (s != run_state || port != prev + 1) flush_run();
+        run_state = s;
+        run.push_back(port);
+        prev = port;
+    }
+    flush_run();
+
+    // Each group keeps the requested order, so a rank-ordered list stays ranked within it.
+    std::vector<int> open, unknown, sampled;
+    for (int port : ports) {
+        uint8_t s = state_of(port);
+        if (s == OPEN) open.push_back(port);
+        else if (s == CLOSED || s == FILTERED) {
+            if (chosen[port]) sampled.push_back(port);
+        } else unknown.push_back(port);
+    }
+
+    open.insert(open.end(), unknown.begin(), unknown.end());
+    open.insert(open.end(), sampled.begin(), sampled.end());
+    return open;
+}
+
+/**
+ * @brief Records a fresh result and counts whether it differs from the baseline.
+ *
+ * @param ip Target address.
+ * @param port Scanned port.
+ * @param proto "tcp" or "udp".
+ * @param state New state.
+ * @return State The state the port had in the baseline (UNKNOWN if it was not scanned).
+ */
+Baseline::State Baseline::update(const std::string &ip, int port, const char *proto, const char *state) {
+    if (port < 0 || port >= static_cast<int>(PORT_COUNT)) return UNKNOWN;
+    std::vector<uint8_t> &states = hosts[{ip, proto}];
+    if (states.empty()) states.assign(PORT_COUNT, UNKNOWN);
+    State old = static_cast<State>(states[port]);
+    State now = parse_state(state);
+    states[port] = now;
+    if (old == now) unchanged++;
+    else changed++;
+    return old;
+}
@@ -0,0 +1,251 @@
+#include "ConnectScanner.hpp"
+#include "ScanOutput.hpp"
+
+/**
+ * @brief Constructs a ConnectScanner instance.
+ *
+ * @param dst Destination IP address (IPv4 or IPv6).
+ * @param src Source IP address to bind the connections to (may be empty).
+ * @param p Vector of target TCP ports to scan.
+ * @param timeout Timeout for a single connection attempt in milliseconds.
+ * @param max_inflight Maximum number of connection attempts in flight at once.
+ */
+ConnectScanner::ConnectScanner(const std::string& dst, const std::string& src, const std::vector<int>& p,
+                               int timeout, int max_inflight)
+    : dst_ip(dst), src_ip(src), ports(p), timeout_ms(timeout), max_inflight(max_inflight) {}
+
+/**
+ * @brief Maps the SO_ERROR value of a finished connect() to a port state.
+ *
+ * @param err Socket error (0 when the connection was established).
+ * @return const char* "open", "closed" or "filtered".
+ */
+static const char *classify_connect_error(int err) {
+    switch (err) {
+        case 0:
+            return "open";
+        case ECONNREFUSED:
+        case ECONNRESET:
+            return "closed";
+        default:
+            return "filtered";
+    }
+}
+
+/**
+ * @brief Fills a sockaddr_storage from a textual IPv4 or IPv6 address.
+ *
+ * @param ip Address string.
+ * @param port Port in host byte order.
+ * @param out Output address.
+ * @return socklen_t Length of the filled address, 0 if the address is invalid.
+ */
+socklen_t make_sockaddr(const std::string &ip, int port, sockaddr_storage &out) {
+    memset(&out, 0, sizeof(out));
+    auto *sin = reinterpret_cast<sockaddr_in*>(&out);
+    if (inet_pton(AF_INET, ip.c_str(), &sin->sin_addr) == 1) {
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        return sizeof(sockaddr_in);
+    }
+    auto *sin6 = reinterpret_cast<sockaddr_in6*>(&out);
+    if (inet_pton(AF_INET6, ip.c_str(), &sin6->sin6_addr) == 1) {
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(port);
+        return sizeof(sockaddr_in6);
+    }
+    return 0;
+}
+
+/**
+ * @brief Raises the soft descriptor limit to the hard limit and returns the usable budget.
+ *
+ * @return int Number of descriptors that may be used for connection attempts.
+ */
+static int descriptor_budget() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 256;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    // Leave room for stdio, the epoll descriptor and anything the process already holds.
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > 1048576) return 1048576;
+    return rl.rlim_cur > 64 ? static_cast<int>(rl.rlim_cur) - 32 : 16;
+}
+
+/**
+ * @brief Starts a non-blocking connection attempt to one port.
+ *
+ * @param port Destination port.
+ * @param dst Destination address (port is overwritten).
+ * @param dst_len Length of the destination address.
+ * @param src Source address to bind to.
+ * @param src_len Length of the source address, 0 to let the kernel choose.
+ * @return int 1 = attempt in flight, 0 = finished immediately, -1 = no descriptor available.
+ */
+int ConnectScanner::start_connect(int port, const sockaddr_storage &dst, socklen_t dst_len,
+                                  const sockaddr_storage &src, socklen_t src_len) {
+    int fd = socket(dst.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) return -1;
+        std::cerr << "connect scan socket error: " << strerror(errno) << std::endl;
+        report_port(dst_ip, port, "tcp", "filtered");
+        return 0;
+    }
+    // Abort with RST on close so finished probes do not linger in TIME_WAIT.
+    struct linger lg{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    if (src_len > 0 && bind(fd, reinterpret_cast<const sockaddr*>(&src), src_len) < 0) {
+        perror("bind");
+    }
+
+    sockaddr_storage addr = dst;
+    if (addr.ss_family == AF_INET)
+        reinterpret_cast<sockaddr_in*>(&addr)->sin_port = htons(port);
+    else
+        reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port = htons(port);
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), dst_len) == 0) {
+        report_port(dst_ip, port, "tcp", "open");
+        close(fd);
+        return 0;
+    }
+    if (errno != EINPROGRESS) {
+        int err = errno;
+        close(fd);
+        if (err == EADDRNOTAVAIL || err == EAGAIN) return -1;
+        report_port(dst_ip, port, "tcp", classify_connect_error(err));
+        return 0;
+    }
+
+    uint32_t idx = free_slots.back();
+    free_slots.pop_back();
+    Slot &s = slots[idx];
+    s.fd = fd;
+    s.port = port;
+    s.gen++;
+
+    struct epoll_event ev{};
+    ev.events = EPOLLOUT;
+    ev.data.u64 = (static_cast<uint64_t>(s.gen) << 32) | idx;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    deadlines.push({std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms), idx, s.gen});
+    inflight++;
+    return 1;
+}
+
+/**
+ * @brief Reports the state of an in-flight attempt and releases its slot.
+ *
+ * @param slot Slot index.
+ * @param state Port state to report.
+ */
+void ConnectScanner::finish(uint32_t slot, const char *state) {
+    Slot &s = slots[slot];
+    report_port(dst_ip, s.port, "tcp", state);
+    close(s.fd);
+    s.fd = -1;
+    s.gen++;
+    free_slots.push_back(slot);
+    inflight--;
+}
+
+/**
+ * @brief Computes the epoll_wait() timeout from the earliest live deadline.
+ *
+ * Entries belonging to slots that already finished are discarded on the way.
+ *
+ * @return int Milliseconds until the nearest deadline, -1 if nothing is pending.
+ */
+int ConnectScanner::next_timeout_ms() {
+    while (!deadlines.empty()) {
+        const Deadline &d = deadlines.top();
+        if (slots[d.slot].gen != d.gen) {
+            deadlines.pop();
+            continue;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            d.when - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<int>(left) + 1 : 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief Scans all specified TCP ports using non-blocking connect() calls.
+ *
+ * Does not need raw sockets, so it works without root or CAP_NET_RAW.
+ */
+void ConnectScanner::scan() {
+    sockaddr_storage dst, src;
+    socklen_t dst_len = make_sockaddr(dst_ip, 0, dst);
+    if (dst_len == 0) {
+        std::cerr << "Invalid destination address " << dst_ip << std::endl;
+        return;
+    }
+    socklen_t src_len = src_ip.empty() ? 0 : make_sockaddr(src_ip, 0, src);
+    if (src_len != 0 && src.ss_family != dst.ss_family) src_len = 0;
+
+    int limit = std::min(max_inflight, descriptor_budget());
+    if (limit < 1) limit = 1;
+    slots.assign(limit, Slot{});
+    free_slots.clear();
+    for (int i = limit - 1; i >= 0; --i) free_slots.push_back(i);
+    deadlines = decltype(deadlines)();
+    inflight = 0;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return;
+    }
+
+    std::vector<struct epoll_event> events(std::min(limit, 1024));
+    size_t next = 0;
+    while (next < ports.size() || inflight > 0) {
+        while (next < ports.size() && !free_slots.empty()) {
+            int r = start_connect(ports[next], dst, dst_len, src, src_len);
+            if (r < 0) {
+                if (inflight == 0) {
+                    std::cerr << "connect scan: out of descriptors" << std::endl;
+                    report_port(dst_ip, ports[next], "tcp", "filtered");
+                    next++;
+                }
+                break;
+            }
+            next++;
+        }
+
+        int n = epoll_wait(epfd, events.data(), events.size(), next_timeout_ms());
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            uint32_t idx = static_cast<uint32_t>(events[i].data.u64);
+            uint32_t gen = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            if (slots[idx].gen != gen || slots[idx].fd < 0) continue;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(slots[idx].fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+            finish(idx, classify_connect_error(err));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        while (!deadlines.empty() && deadlines.top().when <= now) {
+            Deadline d = deadlines.top();
+            deadlines.pop();
+            if (slots[d.slot].gen == d.gen && slots[d.slot].fd >= 0)
+                finish(d.slot, "filtered");
+        }
+    }
+
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        if (slots[i].fd >= 0) close(slots[i].fd);
+    }
+    close(epfd);
+    epfd = -1;
+}
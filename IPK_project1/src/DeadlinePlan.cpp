@@ -0,0 +1,105 @@
+#include "DeadlinePlan.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+static const char *step_name(DeadlinePlan::Step step) {
+    switch (step) {
+        case DeadlinePlan::FULL:       return "full retry budget";
+        case DeadlinePlan::ONE_PROBE:  return "one probe per port";
+        case DeadlinePlan::SHORT_WAIT: return "one probe per port, shortened wait";
+        default:                       return "cutting lowest-priority ports";
+    }
+}
+
+/**
+ * @brief Per-job plan that fits a scan into a fixed time window.
+ *
+ * Before every port the plan compares the time left with the remaining ports times the
+ * measured cost (time per probe, probes per port) and picks the mildest step that fits:
+ * the full retry budget, one probe per port, or one probe with the wait shortened towards the
+ * RTT floor. Ports are scanned in priority order, so when even that is not enough the scan
+ * runs until the window closes and the lowest-priority ports at the end are the ones cut.
+ * A plan without a deadline never limits anything.
+ *
+ * @param deadline End of the window, clock::time_point::max() for none.
+ * @param ports Number of ports in the job.
+ * @param initial_wait_ms Assumed time per probe until the first port is measured.
+ */
+DeadlinePlan::DeadlinePlan(clock::time_point deadline, size_t ports, int initial_wait_ms)
+    : deadline(deadline), start(clock::now()), total(ports), probe_ns(initial_wait_ms * 1e6) {}
+
+/**
+ * @brief Re-plans against the time left and lowers the probe count and wait as needed.
+ *
+ * Each step is announced on stderr the first time the scan has to go that far.
+ *
+ * @param limit Probe count from the retry budget; lowered when the window requires it.
+ * @param wait_ms Normal wait per probe; lowered when needed, but never below floor_ms.
+ * @param floor_ms Shortest useful wait (from the RTT estimate).
+ * @return true If the port is scanned, false if the window is over and the rest is cut.
+ */
+bool DeadlinePlan::next(int &limit, int &wait_ms, int floor_ms) {
+    if (!limited()) return true;
+    auto now = clock::now();
+    double left = std::chrono::duration<double, std::nano>(deadline - now).count();
+    double remaining = static_cast<double>(total - started);
+
+    if (left <= 0) {
+        step = CUT;
+    } else if (remaining * probe_ns * (have_ports ? probes_per_port : limit) <= left) {
+        step = FULL;
+    } else if (remaining * probe_ns <= left) {
+        step = ONE_PROBE;
+        limit = 1;
+    } else {
+        step = SHORT_WAIT;
+        limit = 1;
+        int fit_ms = static_cast<int>(left / remaining / 1e6);
+        wait_ms = std::min(wait_ms, std::max(fit_ms, floor_ms));
+    }
+
+    if (step > worst) {
+        worst = step;
+        double seconds = std::max(left, 0.0) / 1e9;
+        char line[160];
+        snprintf(line, sizeof(line), "%zu ports left in %.1f s need %.0f probes/s at %.1f ms per probe",
+                 total - started, seconds, seconds > 0 ? remaining / seconds : 0.0, probe_ns / 1e6);
+        std::cerr << "deadline: " << line << "; " << step_name(step) << std::endl;
+    }
+    if (step == CUT) return false;
+    started++;
+    return true;
+}
+
+/**
+ * @brief Updates the time per probe and probes per port (moving averages, 1/8 weight).
+ *
+ * @param sent Probes sent for the port.
+ * @param elapsed Time from the first probe to the result.
+ */
+void DeadlinePlan::record(int sent, clock::duration elapsed) {
+    if (!limited() || sent <= 0) return;
+    probes += static_cast<uint64_t>(sent);
+    double per_probe = std::chrono::duration<double, std::nano>(elapsed).count() / sent;
+    probe_ns = have_cost ? probe_ns + (per_probe - probe_ns) / 8 : per_probe;
+    have_cost = true;
+    // Probes per port are only meaningful while the retry budget is not capped.
+    if (step == FULL) {
+        probes_per_port = have_ports ? probes_per_port + (sent - probes_per_port) / 8 : sent;
+        have_ports = true;
+    }
+}
+
+/**
+ * @brief Prints ports scanned and cut, the achieved probe rate and the strongest step to stderr.
+ */
+void DeadlinePlan::print(const std::string &ip, const char *proto) const {
+    if (!limited()) return;
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    char line[200];
+    snprintf(line, sizeof(line), "%s %s deadline: %zu of %zu ports in %.1f s (%.0f probes/s), %zu not scanned, %s",
+             ip.c_str(), proto, started, total, seconds, seconds > 0 ? probes / seconds : 0.0,
+             total - started, step_name(worst));
+    std::cerr << line << std::endl;
+}
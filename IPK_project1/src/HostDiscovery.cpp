@@ -0,0 +1,377 @@
+#include "HostDiscovery.hpp"
+#include "TCPScanner.hpp"
+#include <chrono>
+#include <poll.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/tcp.h>
+#include <netinet/if_ether.h>
+#include <linux/if_packet.h>
+#include <sys/ioctl.h>
+
+/** Ports used for the TCP SYN ping. */
+static const uint16_t SYN_PING_PORTS[] = {80, 443, 22};
+/** Ports used for the TCP ACK ping. */
+static const uint16_t ACK_PING_PORTS[] = {80};
+
+/**
+ * @brief Constructs a HostDiscovery instance.
+ *
+ * @param interface Interface used for ARP/NDP on the local subnet.
+ * @param src Source IPv4 address.
+ * @param src6 Source IPv6 address.
+ * @param timeout Time in milliseconds to wait for replies after all probes are sent.
+ */
+HostDiscovery::HostDiscovery(const std::string& interface, const std::string& src, const std::string& src6,
+                             int timeout)
+    : iface(interface), src_ip(src), src_ip6(src6), timeout_ms(timeout),
+      ident(static_cast<uint16_t>(getpid())) {}
+
+/**
+ * @brief Marks an address as responsive if it is one of the targets.
+ */
+void HostDiscovery::mark(const std::string &addr) {
+    auto it = up.find(addr);
+    if (it != up.end()) it->second = true;
+}
+
+/**
+ * @brief Checks whether every target has already answered.
+ */
+bool HostDiscovery::all_up() const {
+    for (const auto &entry : up) {
+        if (!entry.second) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether an address lies in the subnet of one of the interface addresses.
+ *
+ * @param iface Interface name.
+ * @param family AF_INET or AF_INET6.
+ * @param addr Target address in network byte order (4 or 16 bytes).
+ * @return true If the target is on-link.
+ */
+static bool on_local_subnet(const std::string &iface, int family, const uint8_t *addr) {
+    struct ifaddrs *ifaddr = nullptr;
+    if (getifaddrs(&ifaddr) == -1) return false;
+    bool local = false;
+    for (struct ifaddrs *ifa = ifaddr; ifa && !local; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || !ifa->ifa_netmask || ifa->ifa_addr->sa_family != family) continue;
+        if (std::string(ifa->ifa_name) != iface) continue;
+        const uint8_t *own, *mask;
+        size_t len;
+        if (family == AF_INET) {
+            own  = reinterpret_cast<const uint8_t*>(&reinterpret_cast<sockaddr_in*>(ifa->ifa_addr)->sin_addr);
+            mask = reinterpret_cast<const uint8_t*>(&reinterpret_cast<sockaddr_in*>(ifa->ifa_netmask)->sin_addr);
+            len = 4;
+        } else {
+            own  = reinterpret_cast<const uint8_t*>(&reinterpret_cast<sockaddr_in6*>(ifa->ifa_addr)->sin6_addr);
+            mask = reinterpret_cast<const uint8_t*>(&reinterpret_cast<sockaddr_in6*>(ifa->ifa_netmask)->sin6_addr);
+            len = 16;
+        }
+        local = true;
+        for (size_t i = 0; i < len; ++i) {
+            if ((own[i] & mask[i]) != (addr[i] & mask[i])) {
+                local = false;
+                break;
+            }
+        }
+    }
+    freeifaddrs(ifaddr);
+    return local;
+}
+
+/**
+ * @brief Reads the Ethernet address of an interface.
+ *
+ * @return true If the interface has an Ethernet link layer.
+ */
+static bool get_iface_mac(int sock, const std::string &iface, uint8_t mac[6]) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, iface.c_str(), IFNAMSIZ - 1);
+    if (ioctl(sock, SIOCGIFHWADDR, &ifr) < 0) return false;
+    if (ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER) return false;
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+    return true;
+}
+
+/**
+ * @brief Sends an ICMP echo request to an IPv4 target.
+ */
+static void send_echo4(int sock, const in_addr &dst, uint16_t ident) {
+    struct icmphdr icmp;
+    memset(&icmp, 0, sizeof(icmp));
+    icmp.type = ICMP_ECHO;
+    icmp.un.echo.id = htons(ident);
+    icmp.un.echo.sequence = htons(1);
+    icmp.checksum = csum_fold(csum_add(0, &icmp, sizeof(icmp)));
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr = dst;
+    sendto(sock, &icmp, sizeof(icmp), 0, reinterpret_cast<sockaddr*>(&sin), sizeof(sin));
+}
+
+/**
+ * @brief Sends an ICMPv6 echo request to an IPv6 target. The kernel fills in the checksum.
+ */
+static void send_echo6(int sock, const in6_addr &dst, uint16_t ident) {
+    struct icmp6_hdr icmp6;
+    memset(&icmp6, 0, sizeof(icmp6));
+    icmp6.icmp6_type = ICMP6_ECHO_REQUEST;
+    icmp6.icmp6_id = htons(ident);
+    icmp6.icmp6_seq = htons(1);
+    sockaddr_in6 sin6{};
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = dst;
+    sendto(sock, &icmp6, sizeof(icmp6), 0, reinterpret_cast<sockaddr*>(&sin6), sizeof(sin6));
+}
+
+/**
+ * @brief Sends a TCP ping (SYN or ACK) to an IPv4 target through an IP_HDRINCL raw socket.
+ */
+static void send_tcp_ping4(int sock, const in_addr &src, const in_addr &dst,
+                           uint16_t src_port, uint16_t dst_port, bool syn) {
+    TcpProbe<IPv4Family> probe(src, dst);
+    const uint8_t *packet = probe.build(src_port, dst_port, rand(), syn ? TH_SYN : TH_ACK);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr = dst;
+    sendto(sock, packet, probe.size(), 0, reinterpret_cast<const sockaddr*>(&sin), sizeof(sin));
+}
+
+/**
+ * @brief Sends a TCP ping (SYN or ACK) to an IPv6 target. The kernel builds the IPv6 header
+ * and, through IPV6_CHECKSUM, the TCP checksum.
+ */
+static void send_tcp_ping6(int sock, const in6_addr &dst, uint16_t src_port, uint16_t dst_port, bool syn) {
+    struct tcphdr tcph;
+    memset(&tcph, 0, sizeof(tcph));
+    tcph.source = htons(src_port);
+    tcph.dest = htons(dst_port);
+    tcph.seq = htonl(rand());
+    tcph.ack_seq = syn ? 0 : htonl(rand());
+    tcph.doff = 5;
+    tcph.syn = syn;
+    tcph.ack = !syn;
+    tcph.window = htons(65535);
+    sockaddr_in6 sin6{};
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = dst;
+    sendto(sock, &tcph, sizeof(tcph), 0, reinterpret_cast<sockaddr*>(&sin6), sizeof(sin6));
+}
+
+/**
+ * @brief Broadcasts an ARP request for an on-link IPv4 target.
+ */
+static void send_arp(int sock, int ifindex, const uint8_t mac[6], const in_addr &src, const in_addr &dst) {
+    struct ether_arp req;
+    memset(&req, 0, sizeof(req));
+    req.arp_hrd = htons(ARPHRD_ETHER);
+    req.arp_pro = htons(ETH_P_IP);
+    req.arp_hln = 6;
+    req.arp_pln = 4;
+    req.arp_op = htons(ARPOP_REQUEST);
+    memcpy(req.arp_sha, mac, 6);
+    memcpy(req.arp_spa, &src, 4);
+    memcpy(req.arp_tpa, &dst, 4);
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ARP);
+    sll.sll_ifindex = ifindex;
+    sll.sll_halen = 6;
+    memset(sll.sll_addr, 0xff, 6);
+    sendto(sock, &req, sizeof(req), 0, reinterpret_cast<sockaddr*>(&sll), sizeof(sll));
+}
+
+/**
+ * @brief Sends an NDP neighbor solicitation for an on-link IPv6 target to its solicited-node group.
+ */
+static void send_neighbor_solicit(int sock, const uint8_t mac[6], const in6_addr &dst) {
+    uint8_t msg[sizeof(struct nd_neighbor_solicit) + 8];
+    memset(msg, 0, sizeof(msg));
+    auto *ns = reinterpret_cast<struct nd_neighbor_solicit*>(msg);
+    ns->nd_ns_type = ND_NEIGHBOR_SOLICIT;
+    ns->nd_ns_target = dst;
+    auto *opt = reinterpret_cast<struct nd_opt_hdr*>(msg + sizeof(struct nd_neighbor_solicit));
+    opt->nd_opt_type = ND_OPT_SOURCE_LINKADDR;
+    opt->nd_opt_len = 1;
+    memcpy(msg + sizeof(struct nd_neighbor_solicit) + 2, mac, 6);
+
+    sockaddr_in6 group{};
+    group.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "ff02::1:ff00:0", &group.sin6_addr);
+    group.sin6_addr.s6_addr[13] = dst.s6_addr[13];
+    group.sin6_addr.s6_addr[14] = dst.s6_addr[14];
+    group.sin6_addr.s6_addr[15] = dst.s6_addr[15];
+    sendto(sock, msg, sizeof(msg), 0, reinterpret_cast<sockaddr*>(&group), sizeof(group));
+}
+
+/**
+ * @brief Probes all addresses at once and returns those that answered before the timeout.
+ *
+ * @param addrs Candidate addresses (IPv4 and IPv6 may be mixed).
+ * @return std::vector<std::string> Responsive addresses, in input order.
+ */
+std::vector<std::string> HostDiscovery::alive(const std::vector<std::string>& addrs) {
+    up.clear();
+    std::vector<in_addr> targets4;
+    std::vector<in6_addr> targets6;
+    for (const auto &a : addrs) {
+        in_addr a4;
+        in6_addr a6;
+        if (inet_pton(AF_INET, a.c_str(), &a4) == 1 && !src_ip.empty()) targets4.push_back(a4);
+        else if (inet_pton(AF_INET6, a.c_str(), &a6) == 1 && !src_ip6.empty()) targets6.push_back(a6);
+        else continue;
+        up[a] = false;
+    }
+
+    int ifindex = if_nametoindex(iface.c_str());
+    int icmp4 = targets4.empty() ? -1 : socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    int tcp4  = targets4.empty() ? -1 : socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    int arp   = targets4.empty() ? -1 : socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_ARP));
+    int icmp6 = targets6.empty() ? -1 : socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+    int tcp6  = targets6.empty() ? -1 : socket(AF_INET6, SOCK_RAW, IPPROTO_TCP);
+    if ((!targets4.empty() && (icmp4 < 0 || tcp4 < 0)) || (!targets6.empty() && (icmp6 < 0 || tcp6 < 0))) {
+        // Without raw sockets there is nothing to probe with; treat every target as up.
+        std::cerr << "Host discovery needs raw sockets, skipping: " << strerror(errno) << std::endl;
+        for (int fd : {icmp4, tcp4, arp, icmp6, tcp6}) if (fd >= 0) close(fd);
+        return addrs;
+    }
+
+    int one = 1;
+    uint16_t src_port = 40000 + (rand() % 20000);
+    uint8_t mac[6];
+    bool have_mac = false;
+
+    if (!targets4.empty()) {
+        in_addr src4;
+        inet_pton(AF_INET, src_ip.c_str(), &src4);
+        setsockopt(tcp4, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one));
+        if (arp >= 0) {
+            have_mac = get_iface_mac(arp, iface, mac);
+            struct sockaddr_ll sll;
+            memset(&sll, 0, sizeof(sll));
+            sll.sll_family = AF_PACKET;
+            sll.sll_protocol = htons(ETH_P_ARP);
+            sll.sll_ifindex = ifindex;
+            bind(arp, reinterpret_cast<sockaddr*>(&sll), sizeof(sll));
+        }
+        for (const auto &dst : targets4) {
+            send_echo4(icmp4, dst, ident);
+            for (uint16_t port : SYN_PING_PORTS) send_tcp_ping4(tcp4, src4, dst, src_port, port, true);
+            for (uint16_t port : ACK_PING_PORTS) send_tcp_ping4(tcp4, src4, dst, src_port, port, false);
+            if (arp >= 0 && have_mac && on_local_subnet(iface, AF_INET, reinterpret_cast<const uint8_t*>(&dst)))
+                send_arp(arp, ifindex, mac, src4, dst);
+        }
+    }
+    if (!targets6.empty()) {
+        sockaddr_in6 src6{};
+        src6.sin6_family = AF_INET6;
+        inet_pton(AF_INET6, src_ip6.c_str(), &src6.sin6_addr);
+        bind(tcp6, reinterpret_cast<sockaddr*>(&src6), sizeof(src6));
+        int offset = 16;
+        setsockopt(tcp6, IPPROTO_IPV6, IPV6_CHECKSUM, &offset, sizeof(offset));
+        int hops = 255;
+        setsockopt(icmp6, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+        setsockopt(icmp6, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof(ifindex));
+        if (!have_mac) {
+            int probe = socket(AF_INET6, SOCK_DGRAM, 0);
+            if (probe >= 0) {
+                have_mac = get_iface_mac(probe, iface, mac);
+                close(probe);
+            }
+        }
+        for (const auto &dst : targets6) {
+            send_echo6(icmp6, dst, ident);
+            for (uint16_t port : SYN_PING_PORTS) send_tcp_ping6(tcp6, dst, src_port, port, true);
+            for (uint16_t port : ACK_PING_PORTS) send_tcp_ping6(tcp6, dst, src_port, port, false);
+            if (have_mac && on_local_subnet(iface, AF_INET6, dst.s6_addr))
+                send_neighbor_solicit(icmp6, mac, dst);
+        }
+    }
+
+    struct pollfd fds[5];
+    int nfds = 0;
+    for (int fd : {icmp4, tcp4, arp, icmp6, tcp6}) {
+        if (fd >= 0) fds[nfds++] = {fd, POLLIN, 0};
+    }
+
+    char buf[BUFFER_SIZE];
+    char name[INET6_ADDRSTRLEN];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!all_up()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        if (poll(fds, nfds, static_cast<int>(left)) <= 0) break;
+        for (int i = 0; i < nfds; ++i) {
+            if (!(fds[i].revents & POLLIN)) continue;
+            int fd = fds[i].fd;
+            sockaddr_in6 from{};
+            socklen_t from_len = sizeof(from);
+            ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+            if (n <= 0) continue;
+
+            if (fd == icmp4 || fd == tcp4) {
+                if (n < static_cast<ssize_t>(sizeof(struct iphdr))) continue;
+                struct iphdr *iph = reinterpret_cast<struct iphdr*>(buf);
+                size_t hlen = iph->ihl * 4;
+                if (fd == icmp4) {
+                    if (n < static_cast<ssize_t>(hlen + sizeof(struct icmphdr))) continue;
+                    struct icmphdr *icmp = reinterpret_cast<struct icmphdr*>(buf + hlen);
+                    if (icmp->type == ICMP_ECHO) continue;
+                    if (icmp->type == ICMP_ECHOREPLY && ntohs(icmp->un.echo.id) != ident) continue;
+                } else {
+                    if (n < static_cast<ssize_t>(hlen + sizeof(struct tcphdr))) continue;
+                    struct tcphdr *tcph = reinterpret_cast<struct tcphdr*>(buf + hlen);
+                    if (ntohs(tcph->dest) != src_port) continue;
+                }
+                inet_ntop(AF_INET, &iph->saddr, name, sizeof(name));
+                mark(name);
+            } else if (fd == arp) {
+                if (n < static_cast<ssize_t>(sizeof(struct ether_arp))) continue;
+                struct ether_arp *rep = reinterpret_cast<struct ether_arp*>(buf);
+                if (ntohs(rep->arp_op) != ARPOP_REPLY) continue;
+                inet_ntop(AF_INET, rep->arp_spa, name, sizeof(name));
+                mark(name);
+            } else if (fd == icmp6) {
+                if (n < static_cast<ssize_t>(sizeof(struct icmp6_hdr))) continue;
+                struct icmp6_hdr *icmp6h = reinterpret_cast<struct icmp6_hdr*>(buf);
+                if (icmp6h->icmp6_type == ND_NEIGHBOR_ADVERT &&
+                    n >= static_cast<ssize_t>(sizeof(struct nd_neighbor_advert))) {
+                    auto *na = reinterpret_cast<struct nd_neighbor_advert*>(buf);
+                    inet_ntop(AF_INET6, &na->nd_na_target, name, sizeof(name));
+                    mark(name);
+                    continue;
+                }
+                if (icmp6h->icmp6_type == ICMP6_ECHO_REPLY && ntohs(icmp6h->icmp6_id) != ident) continue;
+                if (icmp6h->icmp6_type != ICMP6_ECHO_REPLY && icmp6h->icmp6_type >= 128) continue;
+                inet_ntop(AF_INET6, &from.sin6_addr, name, sizeof(name));
+                mark(name);
+            } else if (fd == tcp6) {
+                if (n < static_cast<ssize_t>(sizeof(struct tcphdr))) continue;
+                struct tcphdr *tcph = reinterpret_cast<struct tcphdr*>(buf);
+                if (ntohs(tcph->dest) != src_port) continue;
+                inet_ntop(AF_INET6, &from.sin6_addr, name, sizeof(name));
+                mark(name);
+            }
+        }
+    }
+
+    for (int fd : {icmp4, tcp4, arp, icmp6, tcp6}) if (fd >= 0) close(fd);
+
+    std::vector<std::string> result;
+    for (const auto &a : addrs) {
+        auto it = up.find(a);
+        if (it == up.end() || it->second) result.push_back(a);
+    }
+    return result;
+}
@@ -0,0 +1,211 @@
+#include "NextHop.hpp"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+
+static const size_t NL_BUFFER = 32768;
+
+/**
+ * @brief Sends one netlink request and calls @p handle for every message of the answer.
+ *
+ * Multipart answers (dumps) are read until NLMSG_DONE.
+ *
+ * @return true If the answer was read without a netlink error.
+ */
+template <class Handler>
+static bool netlink_request(nlmsghdr *req, Handler handle) {
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) return false;
+    sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(sock, req, req->nlmsg_len, 0, reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        close(sock);
+        return false;
+    }
+    static thread_local char buf[NL_BUFFER];
+    bool ok = true, done = false;
+    while (!done) {
+        pollfd pfd{sock, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0) { ok = false; break; }
+        ssize_t len = recv(sock, buf, sizeof(buf), 0);
+        if (len <= 0) { ok = false; break; }
+        for (nlmsghdr *msg = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(msg, static_cast<unsigned>(len));
+             msg = NLMSG_NEXT(msg, len)) {
+            if (msg->nlmsg_type == NLMSG_DONE) { done = true; break; }
+            if (msg->nlmsg_type == NLMSG_ERROR) {
+                ok = reinterpret_cast<nlmsgerr*>(NLMSG_DATA(msg))->error == 0;
+                done = true;
+                break;
+            }
+            handle(msg);
+            if (!(msg->nlmsg_flags & NLM_F_MULTI)) done = true;
+        }
+    }
+    close(sock);
+    return ok;
+}
+
+/**
+ * @brief Looks up the route to @p dst: gateway (or the destination when on-link) and interface.
+ */
+static bool route_next_hop(int family, const void *dst, size_t addr_len, uint8_t *hop, int &oif) {
+    struct {
+        nlmsghdr hdr;
+        rtmsg rt;
+        char attrs[64];
+    } req{};
+    req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(rtmsg));
+    req.hdr.nlmsg_type = RTM_GETROUTE;
+    req.hdr.nlmsg_flags = NLM_F_REQUEST;
+    req.rt.rtm_family = static_cast<unsigned char>(family);
+    req.rt.rtm_dst_len = static_cast<unsigned char>(addr_len * 8);
+    rtattr *attr = reinterpret_cast<rtattr*>(reinterpret_cast<char*>(&req) + NLMSG_ALIGN(req.hdr.nlmsg_len));
+    attr->rta_type = RTA_DST;
+    attr->rta_len = static_cast<unsigned short>(RTA_LENGTH(addr_len));
+    memcpy(RTA_DATA(attr), dst, addr_len);
+    req.hdr.nlmsg_len = NLMSG_ALIGN(req.hdr.nlmsg_len) + RTA_ALIGN(attr->rta_len);
+
+    bool found = false, gateway = false;
+    oif = 0;
+    bool ok = netlink_request(&req.hdr, [&](nlmsghdr *msg) {
+        if (msg->nlmsg_type != RTM_NEWROUTE) return;
+        rtmsg *rt = reinterpret_cast<rtmsg*>(NLMSG_DATA(msg));
+        int len = static_cast<int>(RTM_PAYLOAD(msg));
+        for (rtattr *a = RTM_RTA(rt); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+            if (a->rta_type == RTA_OIF) oif = *reinterpret_cast<int*>(RTA_DATA(a));
+            else if (a->rta_type == RTA_GATEWAY && RTA_PAYLOAD(a) == addr_len) {
+                memcpy(hop, RTA_DATA(a), addr_len);
+                gateway = true;
+            }
+        }
+        found = true;
+    });
+    if (!ok || !found) return false;
+    if (!gateway) memcpy(hop, dst, addr_len);
+    return true;
+}
+
+/**
+ * @brief Finds a usable neighbour table entry for @p hop on the interface.
+ */
+static bool neighbor_mac(int family, int ifindex, const uint8_t *hop, size_t addr_len, uint8_t mac[6]) {
+    struct {
+        nlmsghdr hdr;
+        ndmsg nd;
+    } req{};
+    req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(ndmsg));
+    req.hdr.nlmsg_type = RTM_GETNEIGH;
+    req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nd.ndm_family = static_cast<uint8_t>(family);
+
+    const uint16_t usable = NUD_REACHABLE | NUD_STALE | NUD_DELAY | NUD_PROBE | NUD_PERMANENT | NUD_NOARP;
+    bool found = false;
+    netlink_request(&req.hdr, [&](nlmsghdr *msg) {
+        if (found || msg->nlmsg_type != RTM_NEWNEIGH) return;
+        ndmsg *nd = reinterpret_cast<ndmsg*>(NLMSG_DATA(msg));
+        if (nd->ndm_ifindex != ifindex || !(nd->ndm_state & usable)) return;
+        int len = static_cast<int>(msg->nlmsg_len - NLMSG_LENGTH(sizeof(ndmsg)));
+        const uint8_t *addr = nullptr, *lladdr = nullptr;
+        for (rtattr *a = reinterpret_cast<rtattr*>(reinterpret_cast<char*>(nd) + NLMSG_ALIGN(sizeof(ndmsg)));
+             RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+            if (a->rta_type == NDA_DST && RTA_PAYLOAD(a) == addr_len)
+                addr = static_cast<const uint8_t*>(RTA_DATA(a));
+            else if (a->rta_type == NDA_LLADDR && RTA_PAYLOAD(a) == 6)
+                lladdr = static_cast<const uint8_t*>(RTA_DATA(a));
+        }
+        if (addr && lladdr && memcmp(addr, hop, addr_len) == 0) {
+            memcpy(mac, lladdr, 6);
+            found = true;
+        }
+    });
+    return found;
+}
+
+/**
+ * @brief Makes the kernel resolve @p hop by sending it one UDP datagram to the discard port.
+ */
+static void poke_neighbor(int family, const uint8_t *hop, size_t addr_len) {
+    int sock = socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return;
+    sockaddr_storage addr{};
+    socklen_t len;
+    if (family == AF_INET) {
+        auto *sin = reinterpret_cast<sockaddr_in*>(&addr);
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(9);
+        memcpy(&sin->sin_addr, hop, addr_len);
+        len = sizeof(sockaddr_in);
+    } else {
+        auto *sin6 = reinterpret_cast<sockaddr_in6*>(&addr);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(9);
+        memcpy(&sin6->sin6_addr, hop, addr_len);
+        len = sizeof(sockaddr_in6);
+    }
+    char byte = 0;
+    sendto(sock, &byte, 1, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&addr), len);
+    close(sock);
+}
+
+/**
+ * @brief Resolves the source and next-hop MAC addresses for a destination.
+ *
+ * @param iface Interface the frames will be sent on.
+ * @param family AF_INET or AF_INET6.
+ * @param dst Destination address.
+ * @param out Filled in on success.
+ * @return true If both addresses are known; the reason is printed otherwise.
+ */
+bool resolve_link_target(const std::string &iface, int family, const void *dst, LinkTarget &out) {
+    size_t addr_len = family == AF_INET ? sizeof(in_addr) : sizeof(in6_addr);
+    out.ifindex = static_cast<int>(if_nametoindex(iface.c_str()));
+    if (out.ifindex == 0) {
+        std::cerr << "Unknown interface " << iface << "\n";
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return false;
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, iface.c_str(), IFNAMSIZ - 1);
+    bool have_mac = ioctl(sock, SIOCGIFHWADDR, &ifr) == 0;
+    close(sock);
+    if (!have_mac) return false;
+    if (ifr.ifr_hwaddr.sa_family == ARPHRD_LOOPBACK) {
+        memset(out.src_mac, 0, 6);
+        memset(out.dst_mac, 0, 6);
+        return true;
+    }
+    if (ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER) {
+        std::cerr << iface << " is not an Ethernet interface\n";
+        return false;
+    }
+    memcpy(out.src_mac, ifr.ifr_hwaddr.sa_data, 6);
+
+    uint8_t hop[16];
+    int oif;
+    if (!route_next_hop(family, dst, addr_len, hop, oif)) {
+        std::cerr << "No route to the target\n";
+        return false;
+    }
+    if (oif != out.ifindex) {
+        std::cerr << "The route to the target does not leave through " << iface << "\n";
+        return false;
+    }
+    for (int attempt = 0; attempt < 10; attempt++) {
+        if (neighbor_mac(family, out.ifindex, hop, addr_len, out.dst_mac)) return true;
+        if (attempt == 0) poke_neighbor(family, hop, addr_len);
+        usleep(100000);
+    }
+    std::cerr << "Next hop MAC address could not be resolved\n";
+    return false;
+}
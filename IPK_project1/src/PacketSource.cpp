@@ -0,0 +1,146 @@
+#include "PacketSource.hpp"
+#include <chrono>
+#include <poll.h>
+#include "Timing.hpp"
+
+/**
+ * @brief Receives the next packet from the raw socket.
+ */
+ssize_t SocketSource::next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) {
+    ssize_t n = io.recv(buffer, sizeof(buffer), timeout_ms, stamp);
+    pkt = buffer;
+    return n;
+}
+
+RawSocketSource::RawSocketSource(int sock) : sock(sock) {
+    enable_rx_timestamps(sock);
+}
+
+/**
+ * @brief Receives the next packet from the socket, polling until the timeout.
+ */
+ssize_t RawSocketSource::next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) {
+    pkt = buffer;
+    ssize_t n = recv_stamped(sock, buffer, sizeof(buffer), stamp, MSG_DONTWAIT);
+    if (n >= 0 || timeout_ms <= 0) return n;
+    struct pollfd pfd{sock, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) return -1;
+    return recv_stamped(sock, buffer, sizeof(buffer), stamp, MSG_DONTWAIT);
+}
+
+/**
+ * @brief Returns the next packet of either source, polling both descriptors until the timeout.
+ */
+ssize_t MergedSource::next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        ssize_t n = first.next(pkt, 0, stamp);
+        if (n >= 0) return n;
+        n = second.next(pkt, 0, stamp);
+        if (n >= 0) return n;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return -1;
+        struct pollfd pfds[2] = {{first.fd(), POLLIN, 0}, {second.fd(), POLLIN, 0}};
+        poll(pfds, 2, static_cast<int>(left));
+    }
+}
+
+/**
+ * @brief Returns the link-layer header length for a pcap datalink type, -1 if unsupported.
+ */
+int link_header_length(int dlt) {
+    switch (dlt) {
+        case DLT_EN10MB:    return 14;
+        case DLT_LINUX_SLL: return 16;
+        case DLT_NULL:      return 4;
+        case DLT_RAW:       return 0;
+        default:            return -1;
+    }
+}
+
+PcapSource::PcapSource(pcap_t *handle)
+    : handle(handle), link_offset(link_header_length(pcap_datalink(handle))),
+      capture_fd(pcap_get_selectable_fd(handle)) {}
+
+PcapSource::~PcapSource() {
+    pcap_close(handle);
+}
+
+/**
+ * @brief Opens a non-blocking, immediate-mode capture with a BPF filter.
+ *
+ * @param iface Interface to capture on.
+ * @param filter BPF filter expression.
+ * @return std::unique_ptr<PcapSource> nullptr on failure (error already printed).
+ */
+std::unique_ptr<PcapSource> PcapSource::open_live(const std::string &iface, const std::string &filter) {
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_create(iface.c_str(), errbuf);
+    if (!handle) {
+        std::cerr << "pcap_create: " << errbuf << std::endl;
+        return nullptr;
+    }
+    pcap_set_snaplen(handle, 65535);
+    pcap_set_promisc(handle, 1);
+    pcap_set_immediate_mode(handle, 1);
+    bool nano = pcap_set_tstamp_precision(handle, PCAP_TSTAMP_PRECISION_NANO) == 0;
+    if (pcap_activate(handle) < 0) {
+        std::cerr << "pcap_activate: " << pcap_geterr(handle) << std::endl;
+        pcap_close(handle);
+        return nullptr;
+    }
+    struct bpf_program fp;
+    if (pcap_compile(handle, &fp, filter.c_str(), 0, PCAP_NETMASK_UNKNOWN) == -1) {
+        std::cerr << "pcap_compile error: " << pcap_geterr(handle) << std::endl;
+        pcap_close(handle);
+        return nullptr;
+    }
+    if (pcap_setfilter(handle, &fp) == -1) {
+        std::cerr << "pcap_setfilter error: " << pcap_geterr(handle) << std::endl;
+        pcap_freecode(&fp);
+        pcap_close(handle);
+        return nullptr;
+    }
+    pcap_freecode(&fp);
+    if (link_header_length(pcap_datalink(handle)) < 0) {
+        std::cerr << "pcap: unsupported datalink type " << pcap_datalink(handle) << std::endl;
+        pcap_close(handle);
+        return nullptr;
+    }
+    if (pcap_setnonblock(handle, 1, errbuf) == -1) {
+        std::cerr << "pcap_setnonblock: " << errbuf << std::endl;
+        pcap_close(handle);
+        return nullptr;
+    }
+    std::unique_ptr<PcapSource> source(new PcapSource(handle));
+    source->nano = nano;
+    return source;
+}
+
+/**
+ * @brief Returns the next captured packet, polling the capture descriptor until the timeout.
+ */
+ssize_t PcapSource::next(const uint8_t *&pkt, int timeout_ms, timespec *stamp) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        struct pcap_pkthdr *header;
+        const u_char *data;
+        int ret = pcap_next_ex(handle, &header, &data);
+        if (ret < 0) return -1;
+        if (ret == 1) {
+            if (header->caplen <= static_cast<bpf_u_int32>(link_offset)) continue;
+            pkt = data + link_offset;
+            if (stamp) {
+                stamp->tv_sec = header->ts.tv_sec;
+                stamp->tv_nsec = nano ? header->ts.tv_usec : header->ts.tv_usec * 1000L;
+            }
+            return header->caplen - link_offset;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return -1;
+        struct pollfd pfd{capture_fd, POLLIN, 0};
+        poll(&pfd, 1, static_cast<int>(left));
+    }
+}
@@ -0,0 +1,154 @@
+#include "PcapRecorder.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+static PcapRecorder *packet_recorder = nullptr;
+
+/**
+ * @brief Records probes and replies to a pcap file without slowing down the scan.
+ *
+ * Scanner threads copy each packet (IP/IPv6 header onwards, cut at SNAPLEN bytes) into a
+ * preallocated slot ring and return at once; a writer thread drains the ring into a raw-IP
+ * pcap file with nanosecond timestamps. The ring is a bounded multi-producer queue with a
+ * sequence number per slot, so recording takes no lock. If the writer falls behind by the
+ * whole ring, packets are dropped and counted rather than blocking the sender. Use open().
+ */
+PcapRecorder::PcapRecorder() : ring(new Slot[SLOTS]) {
+    for (size_t i = 0; i < SLOTS; i++) ring[i].seq.store(i, std::memory_order_relaxed);
+}
+
+PcapRecorder::~PcapRecorder() {
+    close();
+}
+
+/**
+ * @brief Creates the pcap file (raw IP, nanosecond timestamps) and starts the writer thread.
+ *
+ * @param path Output file.
+ * @return std::unique_ptr<PcapRecorder> nullptr if the file cannot be created.
+ */
+std::unique_ptr<PcapRecorder> PcapRecorder::open(const std::string &path) {
+    std::unique_ptr<PcapRecorder> rec(new PcapRecorder());
+    rec->dead = pcap_open_dead_with_tstamp_precision(DLT_RAW, SNAPLEN, PCAP_TSTAMP_PRECISION_NANO);
+    if (!rec->dead) {
+        std::cerr << "pcap_open_dead failed" << std::endl;
+        return nullptr;
+    }
+    rec->dumper = pcap_dump_open(rec->dead, path.c_str());
+    if (!rec->dumper) {
+        std::cerr << "Cannot create " << path << ": " << pcap_geterr(rec->dead) << std::endl;
+        pcap_close(rec->dead);
+        rec->dead = nullptr;
+        return nullptr;
+    }
+    rec->writer = std::thread(&PcapRecorder::write_loop, rec.get());
+    return rec;
+}
+
+/**
+ * @brief Claims the next slot, copies the packet and publishes it to the writer.
+ *
+ * Lock-free; drops the packet if the ring is full.
+ *
+ * @param pkt Packet starting at the IP/IPv6 header.
+ * @param len Length of the packet.
+ * @param stamp Time the packet was sent or received.
+ */
+void PcapRecorder::record(const void *pkt, size_t len, const timespec &stamp) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &ring[pos % SLOTS];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->stamp = stamp;
+    slot->len = static_cast<uint32_t>(len);
+    slot->caplen = static_cast<uint32_t>(len < SNAPLEN ? len : SNAPLEN);
+    memcpy(slot->data, pkt, slot->caplen);
+    slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Writes the oldest published packet, if any.
+ *
+ * @return true If a packet was written.
+ */
+bool PcapRecorder::write_next() {
+    Slot &slot = ring[dequeue_pos % SLOTS];
+    if (slot.seq.load(std::memory_order_acquire) != dequeue_pos + 1) return false;
+    struct pcap_pkthdr hdr;
+    hdr.ts.tv_sec = slot.stamp.tv_sec;
+    // With nanosecond precision the microsecond field carries nanoseconds.
+    hdr.ts.tv_usec = static_cast<suseconds_t>(slot.stamp.tv_nsec);
+    hdr.caplen = slot.caplen;
+    hdr.len = slot.len;
+    pcap_dump(reinterpret_cast<u_char*>(dumper), &hdr, slot.data);
+    slot.seq.store(dequeue_pos + SLOTS, std::memory_order_release);
+    dequeue_pos++;
+    written++;
+    return true;
+}
+
+/**
+ * @brief Writer thread: drains the ring, sleeping briefly whenever it is empty.
+ */
+void PcapRecorder::write_loop() {
+    while (true) {
+        bool any = false;
+        while (write_next()) any = true;
+        if (any) continue;
+        if (stopping.load(std::memory_order_acquire)) {
+            while (write_next()) {}
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * @brief Drains the ring, closes the file and prints the number of packets written and dropped.
+ */
+void PcapRecorder::close() {
+    if (!writer.joinable()) return;
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    pcap_dump_close(dumper);
+    pcap_close(dead);
+    dumper = nullptr;
+    dead = nullptr;
+    std::cerr << "pcap: " << written << " packets written, "
+              << dropped.load(std::memory_order_relaxed) << " dropped" << std::endl;
+}
+
+/**
+ * @brief Makes record_packet() write to a recorder. Must be set before any scan starts.
+ *
+ * @param recorder Open recorder, or nullptr to stop recording.
+ */
+void set_packet_recorder(PcapRecorder *recorder) {
+    packet_recorder = recorder;
+}
+
+/**
+ * @brief True if packets are being recorded; lets callers skip building packets to record.
+ */
+bool packet_recording() {
+    return packet_recorder != nullptr;
+}
+
+/**
+ * @brief Records a sent or received packet if a recorder is set; does nothing otherwise.
+ */
+void record_packet(const void *pkt, size_t len, const timespec &stamp) {
+    if (packet_recorder) packet_recorder->record(pkt, len, stamp);
+}
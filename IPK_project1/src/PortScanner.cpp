@@ -1,6 +1,20 @@
 #include "PortScanner.hpp"
 #include "TCPScanner.hpp"
 #include "UDPScanner.hpp"
+#include "ConnectScanner.hpp"
+#include "HostDiscovery.hpp"
+#include "ScanScheduler.hpp"
+#include "ReplayClassifier.hpp"
+#include "Baseline.hpp"
+#include "StateDb.hpp"
+#include "ScanDaemon.hpp"
+#include "ScanOutput.hpp"
+#include "TopPorts.hpp"
+#include "ShardPlan.hpp"
+#include "BannerGrabber.hpp"
+#include "ScanSummary.hpp"
+#include "PcapRecorder.hpp"
+#include "ScanLoop.hpp"
 
 /**
  * @brief Lists all network interfaces that have an IPv4 or IPv6 address.
@@ -35,7 +49,7 @@ void PortScanner::list_interfaces() const {
  * @param ipv6 True for IPv6 address, false for IPv4.
  * @return std::string The IP address as a string, or an empty string if not found.
  */
-std::string PortScanner::get_ip_from_iface(const std::string &iface, bool ipv6) const {
+std::string PortScanner::get_ip_from_iface(const std::string &iface, bool ipv6) {
     struct ifaddrs *ifaddr = nullptr, *ifa = nullptr;
     if (getifaddrs(&ifaddr) == -1) {
         perror("getifaddrs");
@@ -75,7 +89,7 @@ std::string PortScanner::get_ip_from_iface(const std::string &iface, bool ipv6)
  * @param port_range The string containing the port specification.
  * @return std::vector<int> A vector of parsed port numbers.
  */
-std::vector<int> PortScanner::parse_ports(const std::string &port_range) const {
+std::vector<int> PortScanner::parse_ports(const std::string &port_range) {
     std::vector<int> ports;
     std::istringstream stream(port_range);
     std::string token;
@@ -100,16 +114,16 @@ std::vector<int> PortScanner::parse_ports(const std::string &port_range) const {
  * @brief Resolves a hostname to its corresponding IPv4 and/or IPv6 addresses.
  * 
  * @param hostname The hostname to resolve (e.g. "google.com").
- * @return std::vector<std::string> A list of resolved IP addresses.
+ * @return std::vector<std::string> A list of resolved IP addresses, empty if resolution failed.
  */
-std::vector<std::string> PortScanner::resolve_hostname(const std::string &hostname) const {
+std::vector<std::string> PortScanner::resolve_hostname(const std::string &hostname) {
     std::vector<std::string> addrs;
     struct addrinfo hints{}, *res, *rp;
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
     if (getaddrinfo(hostname.c_str(), nullptr, &hints, &res) != 0) {
         std::cerr << "Failed to resolve hostname: " << hostname << "\n";
-        exit(1);
+        return addrs;
     }
     char buf[INET6_ADDRSTRLEN];
     for (rp = res; rp; rp = rp->ai_next) {
@@ -127,6 +141,30 @@ std::vector<std::string> PortScanner::resolve_hostname(const std::string &hostna
     return addrs;
 }
 
+/**
+ * @brief Parses a duration such as "1500ms", "90s", "20m" or "1h"; a bare number means seconds.
+ *
+ * @param text Duration text.
+ * @return long long Milliseconds, 0 if the text is not a valid duration.
+ */
+static long long parse_duration_ms(const std::string &text) {
+    size_t end = 0;
+    double value;
+    try {
+        value = std::stod(text, &end);
+    } catch (const std::exception &) {
+        return 0;
+    }
+    std::string unit = text.substr(end);
+    double scale;
+    if (unit == "ms") scale = 1;
+    else if (unit.empty() || unit == "s") scale = 1000;
+    else if (unit == "m") scale = 60000;
+    else if (unit == "h") scale = 3600000;
+    else return 0;
+    return static_cast<long long>(value * scale);
+}
+
 /**
  * @brief Prints help/usage information and exits the program.
  */
@@ -143,6 +181,28 @@ void print_help() {
  * - `-pt`: TCP ports (single, range, or list)
  * - `-pu`: UDP ports
  * - `-w, --wait`: Timeout in milliseconds
+ * - `-c, --connect`: Use unprivileged connect() scan for TCP instead of raw SYN packets
+ * - `--io-uring`: Send and receive TCP probes through io_uring when available
+ * - `--event-loop`: Run all raw TCP and UDP jobs as coroutines on one event loop instead of a thread each
+ * - `--discover`: Probe all addresses for liveness first and scan only the responsive ones
+ * - `--replay`: Classify the replies in a saved capture instead of scanning (no target needed)
+ * - `--replay-source`: Scanner address whose packets are the probes in the replayed capture
+ * - `--baseline`: Rescan incrementally against a previous result file and print only changes
+ * - `--sample`: Fraction of each stable closed/filtered run probed in a baseline rescan
+ * - `--db`: Store results in a memory-mapped port-state database instead of printing them
+ * - `--rtt`: Print per-job round-trip time and loss statistics to stderr
+ * - `--min-probes`, `--max-probes`: Bounds for the adaptive number of probes per port
+ * - `--top-ports`, `--top-udp-ports`: Scan the N most frequently open TCP/UDP ports, most likely first
+ * - `--rank-order`: Probe any port list in order of how often each port is open
+ * - `--banners`: Connect to open TCP ports in the background and print the first line they send
+ * - `--summary`: Print open ports only, closed/filtered ports as compressed runs and counts per host
+ * - `--save-pcap`: Record every raw probe and every reply concerning a target to a pcap file
+ * - `--deadline`: Finish within a duration (e.g. 90s, 20m, 1h): fewer retries, shorter waits, cut low-priority ports
+ * - `--tx-ring`: Send TCP probes as Ethernet frames through an AF_PACKET PACKET_TX_RING
+ * - `--tx-bench`: Measure the TCP probe send rate of the raw socket and the TX ring instead of scanning
+ * - `--shard`: Scan only slice i of N of a pseudo-random target x port order shared by all nodes
+ * - `--seed`: Seed of that order (default 0; must be the same on every node)
+ * - `--daemon`: Serve scan jobs on a Unix domain socket instead of scanning a target
  * - `-h, --help`: Show help
  * 
  * @param argc Argument count.
@@ -159,25 +219,122 @@ void PortScanner::parse_arguments(int argc, char* argv[]) {
         {"pt", required_argument, nullptr, 't'},
         {"pu", required_argument, nullptr, 'u'},
         {"wait", required_argument, nullptr, 'w'},
+        {"connect", no_argument, nullptr, 'c'},
+        {"io-uring", no_argument, nullptr, 'U'},
+        {"event-loop", no_argument, nullptr, 'J'},
+        {"discover", no_argument, nullptr, 'D'},
+        {"replay", required_argument, nullptr, 'R'},
+        {"replay-source", required_argument, nullptr, 'Q'},
+        {"baseline", required_argument, nullptr, 'B'},
+        {"sample", required_argument, nullptr, 'S'},
+        {"db", required_argument, nullptr, 'M'},
+        {"rtt", no_argument, nullptr, 'T'},
+        {"min-probes", required_argument, nullptr, 'P'},
+        {"max-probes", required_argument, nullptr, 'X'},
+        {"top-ports", required_argument, nullptr, 'N'},
+        {"top-udp-ports", required_argument, nullptr, 'V'},
+        {"rank-order", no_argument, nullptr, 'K'},
+        {"banners", no_argument, nullptr, 'O'},
+        {"summary", no_argument, nullptr, 'Z'},
+        {"save-pcap", required_argument, nullptr, 'W'},
+        {"deadline", required_argument, nullptr, 'L'},
+        {"tx-ring", no_argument, nullptr, 'G'},
+        {"tx-bench", required_argument, nullptr, 'Y'},
+        {"shard", required_argument, nullptr, 'H'},
+        {"seed", required_argument, nullptr, 'E'},
+        {"daemon", required_argument, nullptr, 'A'},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, 0, nullptr, 0}
     };
     int opt;
-    while ((opt = getopt_long(argc, argv, "i:t:u:w:h", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:t:u:w:ch", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'i': interface = optarg; break;
             case 't': tcp_ports = parse_ports(optarg); break;
             case 'u': udp_ports = parse_ports(optarg); break;
             case 'w': timeout_ms = std::stoi(optarg); break;
+            case 'c': connect_scan = true; break;
+            case 'U': use_uring = true; break;
+            case 'J': event_loop = true; break;
+            case 'D': discover = true; break;
+            case 'R': replay_file = optarg; break;
+            case 'Q': {
+                in6_addr addr;
+                if (inet_pton(AF_INET, optarg, &addr) != 1 && inet_pton(AF_INET6, optarg, &addr) != 1) {
+                    std::cerr << "Replay source must be an IPv4 or IPv6 address!\n";
+                    exit(1);
+                }
+                replay_source = optarg;
+                break;
+            }
+            case 'B': baseline_file = optarg; break;
+            case 'M': db_file = optarg; break;
+            case 'T': show_rtt = true; break;
+            case 'P': min_probes = std::stoi(optarg); break;
+            case 'X': max_probes = std::stoi(optarg); break;
+            case 'K': rank_ports = true; break;
+            case 'O': grab_banners = true; break;
+            case 'Z': summary_output = true; break;
+            case 'W': pcap_file = optarg; break;
+            case 'G': tx_ring = true; break;
+            case 'L':
+                deadline_ms = parse_duration_ms(optarg);
+                if (deadline_ms <= 0) {
+                    std::cerr << "Deadline must be a positive duration (e.g. 90s, 20m, 1h)!\n";
+                    exit(1);
+                }
+                // Ports are cut from the end of the list, so the list has to be in priority order.
+                rank_ports = true;
+                break;
+            case 'Y':
+                tx_bench = std::stoi(optarg);
+                if (tx_bench < 1) {
+                    std::cerr << "Benchmark packet count must be positive!\n";
+                    exit(1);
+                }
+                break;
+            case 'H':
+                if (!shard.parse(optarg)) {
+                    std::cerr << "Shard must be i/N with 1 <= i <= N!\n";
+                    exit(1);
+                }
+                sharded = true;
+                break;
+            case 'E':
+                shard.seed = std::stoull(optarg);
+                sharded = true;
+                break;
+            case 'A': daemon_socket = optarg; break;
+            case 'N':
+            case 'V': {
+                int count = std::stoi(optarg);
+                if (count < 1 || count > 65535) {
+                    std::cerr << "Top port count must be between 1 and 65535!\n";
+                    exit(1);
+                }
+                (opt == 'N' ? tcp_ports : udp_ports) = top_ports(opt == 'V', count);
+                break;
+            }
+            case 'S':
+                sample_fraction = std::stod(optarg);
+                if (sample_fraction < 0 || sample_fraction > 1) {
+                    std::cerr << "Sample fraction must be between 0 and 1!\n";
+                    exit(1);
+                }
+                break;
             case 'h': print_help(); break;
             default:
                 std::cerr << "Invalid argument!\n";
                 exit(1);
         }
     }
+    if (min_probes < 1 || max_probes < min_probes) {
+        std::cerr << "Probe count bounds must satisfy 1 <= min <= max!\n";
+        exit(1);
+    }
     if (optind < argc)
         target_ip = argv[optind];
-    else {
+    else if (replay_file.empty() && daemon_socket.empty()) {
         std::cerr << "No target specified!\n";
         exit(1);
     }
@@ -187,9 +344,11 @@ void PortScanner::parse_arguments(int argc, char* argv[]) {
  * @brief Determines the source IP address for the selected interface.
  * 
  * Sets both `source_ip` (IPv4) and `source_ip6` (IPv6) for use during scanning.
- * Exits if no usable IP is found.
+ * Exits if no usable IP is found. Not needed when replaying a capture; the daemon looks up
+ * the interfaces of its jobs itself.
  */
 void PortScanner::get_source_ip() {
+    if (!replay_file.empty() || !daemon_socket.empty()) return;
     if (!interface.empty()) {
         source_ip  = get_ip_from_iface(interface, false);
         source_ip6 = get_ip_from_iface(interface, true);
@@ -205,10 +364,88 @@ void PortScanner::get_source_ip() {
 /**
  * @brief Runs TCP and/or UDP scans on all resolved IP addresses for the target.
  * 
- * Uses the selected source IP and ports to initialize TCP/UDP scanners.
+ * Uses the selected source IP and ports to initialize TCP/UDP scanners; the TCP and UDP jobs of
+ * every address run concurrently and TCP falls back to a connect() scan without raw sockets.
+ * Replay, daemon and benchmark modes run instead of a scan; see the option list for the rest.
  */
 void PortScanner::run() {
+    if (!replay_file.empty()) {
+        ReplayClassifier replay(replay_file, replay_source);
+        if (!replay.run()) exit(1);
+        return;
+    }
+    if (!daemon_socket.empty()) {
+        ScanDaemon daemon(daemon_socket, interface, timeout_ms);
+        if (!daemon.serve()) exit(1);
+        return;
+    }
     std::vector<std::string> addrs = resolve_hostname(target_ip);
+    if (addrs.empty()) exit(1);
+    std::map<std::string, std::vector<int>> tcp_for, udp_for;
+    if (sharded) {
+        // Every node has to number the space the same way, whatever order the resolver returned.
+        std::sort(addrs.begin(), addrs.end());
+        addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+        uint64_t per_addr = tcp_ports.size() + udp_ports.size();
+        shard.walk(addrs.size() * per_addr, [&](uint64_t element) {
+            const std::string &ip = addrs[element / per_addr];
+            uint64_t offset = element % per_addr;
+            if (offset < tcp_ports.size()) tcp_for[ip].push_back(tcp_ports[offset]);
+            else udp_for[ip].push_back(udp_ports[offset - tcp_ports.size()]);
+        });
+        addrs.erase(std::remove_if(addrs.begin(), addrs.end(), [&](const std::string &ip) {
+            return !tcp_for.count(ip) && !udp_for.count(ip);
+        }), addrs.end());
+    } else {
+        for (auto &ip : addrs) {
+            tcp_for[ip] = tcp_ports;
+            udp_for[ip] = udp_ports;
+        }
+    }
+    if (rank_ports) {
+        for (auto &entry : tcp_for) rank_order(entry.second, false);
+        for (auto &entry : udp_for) rank_order(entry.second, true);
+    }
+    if (discover) {
+        HostDiscovery discovery(interface, source_ip, source_ip6, timeout_ms);
+        std::vector<std::string> responsive = discovery.alive(addrs);
+        for (auto &ip : addrs) {
+            if (std::find(responsive.begin(), responsive.end(), ip) == responsive.end())
+                std::cout << ip << " skipped (host down)\n";
+        }
+        addrs = responsive;
+    }
+    std::unique_ptr<StateDb> db;
+    if (!db_file.empty()) {
+        db = StateDb::create(db_file, addrs);
+        if (!db) exit(1);
+        set_report_database(db.get());
+    }
+    Baseline baseline;
+    if (!baseline_file.empty()) {
+        if (!baseline.load(baseline_file)) exit(1);
+        set_report_baseline(&baseline);
+    }
+    size_t planned = 0, requested = 0;
+    auto plan = [&](const std::string &ip, const char *proto, const std::vector<int> &ports) {
+        std::vector<int> order = baseline_file.empty() ? ports
+                                                       : baseline.plan(ip, proto, ports, sample_fraction);
+        requested += ports.size();
+        planned += order.size();
+        return order;
+    };
+
+    auto deadline = deadline_ms > 0
+        ? std::chrono::steady_clock::now() + std::chrono::milliseconds(deadline_ms)
+        : std::chrono::steady_clock::time_point::max();
+    ScanScheduler scheduler;
+    std::unique_ptr<ScanLoop> loop;
+    std::vector<std::unique_ptr<TCPScanner>> loop_tcp;
+    std::vector<std::unique_ptr<UDPScanner>> loop_udp;
+    if (event_loop) {
+        loop.reset(new ScanLoop(interface, source_ip, source_ip6));
+        scheduler.add([&loop]() { loop->run(); });
+    }
     for (auto &ip : addrs) {
         bool is_ipv6 = (ip.find(':') != std::string::npos);
         std::string src = is_ipv6 ? source_ip6 : source_ip;
@@ -217,13 +454,82 @@ void PortScanner::run() {
                       << (is_ipv6 ? "IPv6" : "IPv4") << ")\n";
             continue;
         }
-        if (!tcp_ports.empty()) {
-            TCPScanner tcp(interface, ip, src, tcp_ports, timeout_ms);
-            tcp.scan();
+        int family = is_ipv6 ? AF_INET6 : AF_INET;
+        if (loop && !connect_scan && tx_bench == 0 && !tcp_for[ip].empty() && loop->open_tcp(family)) {
+            loop_tcp.emplace_back(new TCPScanner(interface, ip, src, plan(ip, "tcp", tcp_for[ip]), timeout_ms,
+                                                 false, show_rtt, min_probes, max_probes));
+            loop_tcp.back()->use_deadline(deadline);
+            loop_tcp.back()->schedule(*loop);
+            tcp_for[ip].clear();
         }
-        if (!udp_ports.empty()) {
-            UDPScanner udp(ip, udp_ports, timeout_ms);
-            udp.scan();
+        if (loop && tx_bench == 0 && !udp_for[ip].empty() && loop->open_udp(family)) {
+            loop_udp.emplace_back(new UDPScanner(ip, plan(ip, "udp", udp_for[ip]), timeout_ms, show_rtt,
+                                                 min_probes, max_probes));
+            loop_udp.back()->use_deadline(deadline);
+            loop_udp.back()->schedule(*loop);
+            udp_for[ip].clear();
         }
+        if (!tcp_for[ip].empty()) {
+            scheduler.add([this, ip, src, deadline, ports = plan(ip, "tcp", tcp_for[ip])]() {
+                TCPScanner tcp(interface, ip, src, ports, timeout_ms, use_uring, show_rtt,
+                               min_probes, max_probes);
+                tcp.use_tx_ring(tx_ring);
+                tcp.use_deadline(deadline);
+                if (tx_bench > 0) {
+                    if (!tcp.benchmark(static_cast<unsigned>(tx_bench)))
+                        std::cerr << "Raw sockets unavailable, cannot run the transmit benchmark" << std::endl;
+                    return;
+                }
+                if (connect_scan || !tcp.scan()) {
+                    if (!connect_scan)
+                        std::cerr << "Raw sockets unavailable, falling back to connect() scan" << std::endl;
+                    ConnectScanner conn(ip, src, ports, timeout_ms);
+                    conn.scan();
+                }
+            });
+        }
+        if (!udp_for[ip].empty() && tx_bench == 0) {
+            scheduler.add([this, ip, deadline, ports = plan(ip, "udp", udp_for[ip])]() {
+                UDPScanner udp(ip, ports, timeout_ms, show_rtt, min_probes, max_probes);
+                udp.use_deadline(deadline);
+                udp.scan();
+            });
+        }
+    }
+    ScanSummary summary;
+    if (summary_output) set_report_summary(&summary);
+    std::unique_ptr<BannerGrabber> banners;
+    if (grab_banners && tx_bench == 0) {
+        banners.reset(new BannerGrabber());
+        set_report_banners(banners.get());
+    }
+    std::unique_ptr<PcapRecorder> recorder;
+    if (!pcap_file.empty() && tx_bench == 0) {
+        recorder = PcapRecorder::open(pcap_file);
+        if (!recorder) exit(1);
+        set_packet_recorder(recorder.get());
+    }
+    std::cout << std::flush;
+    scheduler.run();
+    if (recorder) {
+        set_packet_recorder(nullptr);
+        recorder->close();
+    }
+    if (banners) {
+        banners->close();
+        set_report_banners(nullptr);
+    }
+    if (summary_output) {
+        set_report_summary(nullptr);
+        summary.print(std::cout);
+    }
+
+    if (!baseline_file.empty()) {
+        set_report_baseline(nullptr);
+        std::cerr << "baseline: " << baseline.changed_count() << " changed, "
+                  << baseline.unchanged_count() << " unchanged, "
+                  << (requested - planned) << " stable ports not probed" << std::endl;
+        if (!baseline.save(baseline_file)) exit(1);
     }
+    if (db) set_report_database(nullptr);
 }
@@ -0,0 +1,538 @@
+#include "ProbeIO.hpp"
+#include "Timing.hpp"
+#include <iostream>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/time_types.h>
+#include <poll.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+
+static const uint64_t SEND_TAG = 1ULL << 32;
+static const uint64_t RECV_TAG = 2ULL << 32;
+static const uint64_t NOP_TAG = 3ULL << 32;
+
+/**
+ * @brief Constructs the sendto()/recvfrom() backend.
+ *
+ * @param sock Raw socket.
+ * @param dst Destination address used for every sendto().
+ * @param dst_len Length of the destination address.
+ */
+SocketIO::SocketIO(int sock, const sockaddr *dst, socklen_t dst_len)
+    : sock(sock), dst_len(dst_len) {
+    memset(&this->dst, 0, sizeof(this->dst));
+    memcpy(&this->dst, dst, dst_len);
+}
+
+/**
+ * @brief Sends one packet with sendto().
+ */
+bool SocketIO::send(const void *pkt, size_t len) {
+    if (sendto(sock, pkt, len, 0, reinterpret_cast<const sockaddr*>(&dst), dst_len) < 0) {
+        perror("sendto");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Receives one packet with its kernel timestamp, waiting at most timeout_ms.
+ */
+ssize_t SocketIO::recv(void *buf, size_t len, int timeout_ms, timespec *stamp) {
+    if (timeout_ms <= 0) return recv_stamped(sock, buf, len, stamp, MSG_DONTWAIT);
+    if (timeout_ms != rcv_timeout_ms) {
+        struct timeval tv;
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+        rcv_timeout_ms = timeout_ms;
+    }
+    return recv_stamped(sock, buf, len, stamp);
+}
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              const void *arg, size_t argsz) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/**
+ * @brief Constructs an uninitialized io_uring backend. Use UringIO::create().
+ */
+UringIO::UringIO(int sock, bool receive) : sock(sock), receive(receive) {}
+
+/**
+ * @brief Releases the ring and all mapped buffers.
+ */
+UringIO::~UringIO() {
+    if (ring_fd >= 0) close(ring_fd);
+    if (sqes) munmap(sqes, sqes_len);
+    if (cq_map && cq_map != sq_map) munmap(cq_map, cq_map_len);
+    if (sq_map) munmap(sq_map, sq_map_len);
+    if (send_region) munmap(send_region, SEND_SLOTS * SLOT_SIZE);
+    if (recv_region) munmap(recv_region, RECV_BUFS * SLOT_SIZE);
+    if (buf_ring) munmap(buf_ring, buf_ring_len);
+}
+
+/**
+ * @brief Creates the ring, maps its queues and registers the send and receive buffers.
+ *
+ * Fails if the kernel rejects the multishot receive, so create() can fall back to sendto().
+ *
+ * @param want_sqpoll Request a kernel submission thread.
+ * @return true On success.
+ */
+bool UringIO::setup(bool want_sqpoll) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    if (want_sqpoll) {
+        p.flags = IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = 1000;
+    }
+    ring_fd = sys_io_uring_setup(RING_ENTRIES, &p);
+    if (ring_fd < 0) return false;
+    // Timed waits need EXT_ARG (5.11); SQPOLL without registered files needs SQPOLL_NONFIXED.
+    if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_SINGLE_MMAP)) return false;
+    if (want_sqpoll && !(p.features & IORING_FEAT_SQPOLL_NONFIXED)) return false;
+    sqpoll = want_sqpoll;
+
+    sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_map_len > sq_map_len) sq_map_len = cq_map_len;
+    cq_map_len = sq_map_len;
+    sq_map = mmap(nullptr, sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    if (sq_map == MAP_FAILED) { sq_map = nullptr; return false; }
+    cq_map = sq_map;
+    sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) { sqes = nullptr; return false; }
+
+    uint8_t *sq = static_cast<uint8_t*>(sq_map);
+    sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_flags = reinterpret_cast<unsigned*>(sq + p.sq_off.flags);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    uint8_t *cq = static_cast<uint8_t*>(cq_map);
+    cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes    = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    sq_local_tail = *sq_tail;
+
+    // The opcodes used below must all be present.
+    uint8_t probe_buf[sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)] = {};
+    auto *probe = reinterpret_cast<struct io_uring_probe*>(probe_buf);
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+    const int needed[] = {IORING_OP_WRITE_FIXED, IORING_OP_RECV};
+    for (int op : needed) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+
+    send_region = static_cast<uint8_t*>(mmap(nullptr, SEND_SLOTS * SLOT_SIZE, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (send_region == MAP_FAILED) { send_region = nullptr; return false; }
+    struct iovec iov{send_region, SEND_SLOTS * SLOT_SIZE};
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) return false;
+
+    if (!receive) return true;
+
+    // Provided buffer ring for the multishot receive (5.19+).
+    recv_region = static_cast<uint8_t*>(mmap(nullptr, RECV_BUFS * SLOT_SIZE, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (recv_region == MAP_FAILED) { recv_region = nullptr; return false; }
+    buf_ring_len = RECV_BUFS * sizeof(struct io_uring_buf);
+    buf_ring = static_cast<struct io_uring_buf_ring*>(mmap(nullptr, buf_ring_len, PROT_READ | PROT_WRITE,
+                                                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (buf_ring == MAP_FAILED) { buf_ring = nullptr; return false; }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = RECV_BUFS;
+    reg.bgid = 0;
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+    buf_ring_tail = 0;
+    for (uint16_t bid = 0; bid < RECV_BUFS; ++bid) recycle(bid);
+
+    // A kernel without IORING_RECV_MULTISHOT fails the receive at once with -EINVAL (and stops
+    // submitting there). Entries are issued in order, so a completed NOP means it was accepted.
+    arm_recv();
+    struct io_uring_sqe *nop = get_sqe();
+    nop->opcode = IORING_OP_NOP;
+    nop->user_data = NOP_TAG;
+    nop_done = false;
+    submit();
+    while (!nop_done && recv_error == 0) {
+        if (!wait_cqe(1000)) return false;
+        reap();
+    }
+    return recv_armed;
+}
+
+/**
+ * @brief Creates the io_uring backend, preferring SQPOLL.
+ *
+ * @param sock Connected raw socket.
+ * @param receive True if replies are read through the ring.
+ * @return std::unique_ptr<UringIO> nullptr if io_uring cannot be used.
+ */
+std::unique_ptr<UringIO> UringIO::create(int sock, bool receive) {
+    for (bool want_sqpoll : {true, false}) {
+        std::unique_ptr<UringIO> io(new UringIO(sock, receive));
+        if (io->setup(want_sqpoll)) return io;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns a free submission entry, flushing the queue if it is full.
+ */
+struct io_uring_sqe *UringIO::get_sqe() {
+    unsigned mask = *sq_mask;
+    while (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > mask) {
+        submit();
+        if (sqpoll) sys_io_uring_enter(ring_fd, 0, 0, IORING_ENTER_SQ_WAIT, nullptr, 0);
+    }
+    unsigned idx = sq_local_tail & mask;
+    struct io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    sq_local_tail++;
+    return sqe;
+}
+
+/**
+ * @brief Publishes queued entries. With SQPOLL this only enters the kernel to wake an idle thread.
+ *
+ * The full fence orders the tail store before the flags load: otherwise the poller may go
+ * idle without seeing the new tail while we still read a flags word without NEED_WAKEUP.
+ */
+void UringIO::submit() {
+    unsigned tail = __atomic_load_n(sq_tail, __ATOMIC_RELAXED);
+    unsigned pending = sq_local_tail - tail;
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    if (sqpoll) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+            sys_io_uring_enter(ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP, nullptr, 0);
+    } else if (pending > 0) {
+        sys_io_uring_enter(ring_fd, pending, 0, 0, nullptr, 0);
+    }
+}
+
+/**
+ * @brief Drains the completion queue, freeing send slots and collecting received packets.
+ */
+void UringIO::reap() {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned mask = *cq_mask;
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &cqes[head & mask];
+        uint64_t tag = cqe->user_data & ~0xffffffffULL;
+        if (tag == SEND_TAG) {
+            send_busy[cqe->user_data & 0xffffffffULL] = false;
+            if (cqe->res < 0) std::cerr << "io_uring send: " << strerror(-cqe->res) << std::endl;
+        } else if (tag == NOP_TAG) {
+            nop_done = true;
+        } else if (tag == RECV_TAG) {
+            // -ENOBUFS only means every buffer is waiting to be consumed; recv() re-arms after
+            // recycling one. Any other error would fail again, so the receive stays down.
+            if (cqe->res < 0 && cqe->res != -ENOBUFS && recv_error == 0) {
+                recv_error = -cqe->res;
+                if (nop_done) std::cerr << "io_uring recv: " << strerror(recv_error) << std::endl;
+            }
+            if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+                uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                ready_bid[ready_tail % RECV_BUFS] = bid;
+                ready_len[ready_tail % RECV_BUFS] = cqe->res;
+                ready_stamp[ready_tail % RECV_BUFS] = wall_clock_now();
+                ready_tail++;
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE)) recv_armed = false;
+        }
+        head++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Blocks in the kernel until at least one completion arrives or the timeout expires.
+ *
+ * @return true If the wait returned before the timeout.
+ */
+bool UringIO::wait_cqe(int timeout_ms) {
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    int r = sys_io_uring_enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                               &arg, sizeof(arg));
+    return r >= 0 || errno != ETIME;
+}
+
+/**
+ * @brief Posts the multishot receive that feeds the provided buffer ring.
+ */
+void UringIO::arm_recv() {
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sock;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = RECV_TAG;
+    recv_armed = true;
+}
+
+/**
+ * @brief Hands a receive buffer back to the kernel.
+ */
+void UringIO::recycle(uint16_t bid) {
+    // Index the ring as a plain array: the header's flexible-array wrapper shifts bufs[] in C++.
+    struct io_uring_buf *buf = reinterpret_cast<struct io_uring_buf*>(buf_ring) + (buf_ring_tail & (RECV_BUFS - 1));
+    buf->addr = reinterpret_cast<uint64_t>(recv_region + bid * SLOT_SIZE);
+    buf->len = SLOT_SIZE;
+    buf->bid = bid;
+    buf_ring_tail++;
+    __atomic_store_n(&buf_ring->tail, buf_ring_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copies the packet into a registered slot and queues a fixed-buffer write.
+ *
+ * The write is only published by flush() (or by a receive), so a batch of probes costs one
+ * io_uring_enter() without SQPOLL.
+ */
+bool UringIO::send(const void *pkt, size_t len) {
+    if (len > SLOT_SIZE) return false;
+    unsigned slot = next_slot;
+    while (send_busy[slot]) {
+        submit();
+        reap();
+        if (send_busy[slot] && !wait_cqe(1000)) {
+            std::cerr << "io_uring send stalled" << std::endl;
+            return false;
+        }
+    }
+    next_slot = (next_slot + 1) % SEND_SLOTS;
+    uint8_t *dst = send_region + slot * SLOT_SIZE;
+    memcpy(dst, pkt, len);
+    send_busy[slot] = true;
+
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = sock;
+    sqe->addr = reinterpret_cast<uint64_t>(dst);
+    sqe->len = len;
+    sqe->off = 0;
+    sqe->buf_index = 0;
+    sqe->user_data = SEND_TAG | slot;
+    return true;
+}
+
+/**
+ * @brief Publishes the writes queued since the last flush.
+ */
+void UringIO::flush() {
+    submit();
+}
+
+/**
+ * @brief Returns the next packet delivered by the multishot receive.
+ *
+ * Already completed packets are consumed without entering the kernel; only an empty
+ * completion queue makes the call block in io_uring_enter(). The receive op carries no
+ * control messages, so the timestamp is the time its completion was reaped. After a receive
+ * error other than -ENOBUFS the call returns -1 at once instead of re-arming.
+ */
+ssize_t UringIO::recv(void *buf, size_t len, int timeout_ms, timespec *stamp) {
+    if (!receive) return -1;
+    submit();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        reap();
+        if (!recv_armed && recv_error == 0) {
+            arm_recv();
+            submit();
+        }
+        if (ready_head != ready_tail) {
+            uint16_t bid = ready_bid[ready_head % RECV_BUFS];
+            size_t n = static_cast<size_t>(ready_len[ready_head % RECV_BUFS]);
+            if (stamp) *stamp = ready_stamp[ready_head % RECV_BUFS];
+            ready_head++;
+            if (n > len) n = len;
+            memcpy(buf, recv_region + bid * SLOT_SIZE, n);
+            recycle(bid);
+            return static_cast<ssize_t>(n);
+        }
+        if (recv_error != 0) return -1;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return -1;
+        wait_cqe(static_cast<int>(left));
+    }
+}
+
+/**
+ * @brief Constructs an unmapped ring backend. Use PacketRingIO::create().
+ */
+PacketRingIO::PacketRingIO(std::unique_ptr<ProbeIO> inner) : inner(std::move(inner)) {}
+
+/**
+ * @brief Sends what is still queued, then releases the ring.
+ */
+PacketRingIO::~PacketRingIO() {
+    if (ring) {
+        flush();
+        munmap(ring, ring_len);
+    }
+    if (rejected > 0)
+        std::cerr << "packet_tx_ring: " << rejected << " probe(s) failed (rejected by the kernel)" << std::endl;
+    if (fd >= 0) close(fd);
+}
+
+std::unique_ptr<PacketRingIO> PacketRingIO::create(const LinkTarget &link, uint16_t ethertype,
+                                                   std::unique_ptr<ProbeIO> &inner) {
+    std::unique_ptr<PacketRingIO> io(new PacketRingIO(nullptr));
+    // Protocol 0: the socket only transmits and never gets a copy of received traffic.
+    io->fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (io->fd < 0) {
+        perror("AF_PACKET socket");
+        return nullptr;
+    }
+    int version = TPACKET_V2;
+    if (setsockopt(io->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        perror("PACKET_VERSION");
+        return nullptr;
+    }
+    // Frames go straight to the driver; a failure only means they pass the qdisc as usual.
+    int one = 1;
+    setsockopt(io->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+
+    tpacket_req req{};
+    req.tp_frame_size = FRAME_SIZE;
+    req.tp_frame_nr = FRAME_COUNT;
+    req.tp_block_size = FRAME_SIZE * 2;
+    req.tp_block_nr = FRAME_COUNT / 2;
+    if (setsockopt(io->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+        perror("PACKET_TX_RING");
+        return nullptr;
+    }
+    io->ring_len = static_cast<size_t>(req.tp_block_size) * req.tp_block_nr;
+    void *map = mmap(nullptr, io->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, io->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return nullptr;
+    }
+    io->ring = static_cast<uint8_t*>(map);
+
+    sockaddr_ll sll{};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ethertype);
+    sll.sll_ifindex = link.ifindex;
+    if (bind(io->fd, reinterpret_cast<sockaddr*>(&sll), sizeof(sll)) < 0) {
+        perror("bind");
+        return nullptr;
+    }
+
+    struct ether_header *eth = reinterpret_cast<struct ether_header*>(io->eth_header);
+    memcpy(eth->ether_dhost, link.dst_mac, 6);
+    memcpy(eth->ether_shost, link.src_mac, 6);
+    eth->ether_type = htons(ethertype);
+    io->inner = std::move(inner);
+    return io;
+}
+
+/**
+ * @brief Writes one packet into the next free ring slot behind the Ethernet header.
+ *
+ * When the ring is full the queued frames are flushed and the slot is awaited; every BATCH
+ * frames are flushed with one send(). A slot the kernel left as TP_STATUS_WRONG_FORMAT holds
+ * an earlier probe that never went out: it is reported, counted as failed and handed back
+ * as TP_STATUS_AVAILABLE before it is reused.
+ */
+bool PacketRingIO::send(const void *pkt, size_t len) {
+    const size_t data_offset = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    if (data_offset + sizeof(eth_header) + len > FRAME_SIZE) return false;
+
+    auto *hdr = reinterpret_cast<tpacket2_hdr*>(ring + static_cast<size_t>(next_frame) * FRAME_SIZE);
+    uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+    while (status != TP_STATUS_AVAILABLE) {
+        if (status == TP_STATUS_WRONG_FORMAT) {
+            ++rejected;
+            std::cerr << "packet_tx_ring: kernel rejected frame " << next_frame
+                      << " (" << hdr->tp_len << " bytes), probe not sent" << std::endl;
+            __atomic_store_n(&hdr->tp_status, TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+            break;
+        }
+        flush();
+        pollfd pfd{fd, POLLOUT, 0};
+        poll(&pfd, 1, 10);
+        status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+    }
+
+    uint8_t *data = reinterpret_cast<uint8_t*>(hdr) + data_offset;
+    memcpy(data, eth_header, sizeof(eth_header));
+    memcpy(data + sizeof(eth_header), pkt, len);
+    hdr->tp_len = static_cast<uint32_t>(sizeof(eth_header) + len);
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    next_frame = (next_frame + 1) % FRAME_COUNT;
+    if (++pending >= BATCH) flush();
+    return true;
+}
+
+/**
+ * @brief Transmits all queued frames with a single send().
+ */
+void PacketRingIO::flush() {
+    if (pending == 0) return;
+    pending = 0;
+    if (::send(fd, nullptr, 0, 0) < 0) perror("packet_tx_ring send");
+}
+
+/**
+ * @brief Flushes queued probes so they are on the wire, then receives through the wrapped backend.
+ */
+ssize_t PacketRingIO::recv(void *buf, size_t len, int timeout_ms, timespec *stamp) {
+    flush();
+    return inner->recv(buf, len, timeout_ms, stamp);
+}
+
+/**
+ * @brief Selects the probe backend for a raw socket.
+ *
+ * @param sock Raw socket used for probing.
+ * @param dst Address of the scanned host.
+ * @param dst_len Length of the address.
+ * @param receive True if replies are read from the same socket.
+ * @param use_uring Try io_uring first and fall back to sendto()/recvfrom() when unsupported.
+ * @return std::unique_ptr<ProbeIO> The selected backend.
+ */
+std::unique_ptr<ProbeIO> make_probe_io(int sock, const sockaddr *dst, socklen_t dst_len,
+                                       bool receive, bool use_uring) {
+    if (use_uring) {
+        // Fixed-buffer writes carry no address, so the raw socket is connected to the target.
+        if (connect(sock, dst, dst_len) == 0) {
+            std::unique_ptr<UringIO> io = UringIO::create(sock, receive);
+            if (io) return io;
+        }
+        std::cerr << "io_uring unavailable, using sendto/recvfrom" << std::endl;
+    }
+    if (receive) enable_rx_timestamps(sock);
+    return std::unique_ptr<ProbeIO>(new SocketIO(sock, dst, dst_len));
+}
@@ -0,0 +1,66 @@
+#include "ProbePolicy.hpp"
+#include <algorithm>
+
+/**
+ * @brief Per-target probing policy shared by the threaded and the event-loop scans.
+ *
+ * Combines the retry budget (probes per port), the RTT estimate (wait per probe) and the
+ * deadline plan (which may lower both or stop the scan), so every scan loop applies them the
+ * same way and only sends probes and classifies replies itself.
+ *
+ * @param timeout_ms Wait per probe from `-w`.
+ * @param adaptive_wait Replace the wait by the RTT-based timeout once known (TCP). UDP keeps
+ *        `-w`: silence means open, so a shorter wait would turn ICMP rate limiting into opens.
+ * @param initial_probes Probes per port until the retry budget has evidence.
+ * @param min_probes Lower bound for the retry budget.
+ * @param max_probes Upper bound for the retry budget.
+ * @param deadline End of the scan window, time_point::max() for none.
+ * @param ports Number of ports in the scan.
+ */
+ProbePolicy::ProbePolicy(int timeout_ms, bool adaptive_wait, int initial_probes, int min_probes, int max_probes,
+                         clock::time_point deadline, size_t ports)
+    : rtt(timeout_ms), budget(initial_probes, min_probes, max_probes), window(deadline, ports, timeout_ms),
+      timeout_ms(timeout_ms), adaptive_wait(adaptive_wait) {}
+
+/**
+ * @brief Plans the next port: probe count and wait, lowered by the deadline plan if needed.
+ *
+ * @param limit Set to the number of probes to send at most.
+ * @return true If the port is scanned, false if the deadline cuts the remaining ports.
+ */
+bool ProbePolicy::next_port(int &limit) {
+    limit = budget.next_limit();
+    wait = adaptive_wait ? rtt.timeout_ms() : timeout_ms;
+    if (!window.next(limit, wait, rtt.floor_ms())) return false;
+    began = clock::now();
+    return true;
+}
+
+/**
+ * @brief Wait for the current probe; with an adaptive wait it follows samples taken meanwhile.
+ */
+int ProbePolicy::wait_ms() const {
+    return adaptive_wait ? std::min(wait, rtt.timeout_ms()) : wait;
+}
+
+/**
+ * @brief Feeds the outcome of the port planned last to the retry budget and the deadline plan.
+ *
+ * @param sent Probes sent for the port.
+ * @param answered True if the last of them got an answer.
+ */
+void ProbePolicy::finish_port(int sent, bool answered) {
+    budget.record(answered ? sent - 1 : -1, sent);
+    window.record(sent, clock::now() - began);
+}
+
+/**
+ * @brief Prints the RTT and loss statistics (with show_rtt) and the deadline summary to stderr.
+ */
+void ProbePolicy::print(const std::string &ip, const char *proto, bool show_rtt) const {
+    if (show_rtt) {
+        rtt.print(ip, proto);
+        budget.print(ip, proto);
+    }
+    window.print(ip, proto);
+}
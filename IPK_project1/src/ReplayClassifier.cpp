@@ -0,0 +1,261 @@
+#include "ReplayClassifier.hpp"
+#include "AddressFamily.hpp"
+#include "PacketSource.hpp"
+#include "ScanOutput.hpp"
+#include <chrono>
+#include <netinet/udp.h>
+
+// Unmatched frames listed individually before only the count is kept.
+static const uint64_t MAX_UNMATCHED_SHOWN = 20;
+
+/**
+ * @brief FNV-1a over the key bytes.
+ */
+size_t ReplayClassifier::ProbeKeyHash::operator()(const ProbeKey &k) const {
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(&k);
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < sizeof(ProbeKey); i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+/**
+ * @brief Sets the capture and, if given, the scanner address of its family.
+ *
+ * @param source IPv4 or IPv6 address validated by the caller, empty to learn it from the capture.
+ */
+ReplayClassifier::ReplayClassifier(const std::string &file, const std::string &source) : path(file) {
+    if (inet_pton(AF_INET, source.c_str(), source_addr[0]) == 1)
+        have_source[0] = true;
+    else if (inet_pton(AF_INET6, source.c_str(), source_addr[1]) == 1)
+        have_source[1] = true;
+}
+
+/**
+ * @brief Tells whether a SYN or UDP datagram was sent by the scanner.
+ *
+ * Frames to multicast or broadcast addresses (mDNS, SSDP, NTP chatter) are never probes.
+ * Without an explicit address, the sender of the first other such frame of each family is
+ * taken as the scanner.
+ */
+template <class AF>
+bool ReplayClassifier::from_scanner(const typename AF::addr_type &src, const typename AF::addr_type &dst) {
+    const uint8_t *to = reinterpret_cast<const uint8_t*>(&dst);
+    if (AF::family == AF_INET6 ? to[0] == 0xff : to[0] >= 224) return false;
+    int idx = AF::family == AF_INET6;
+    if (!have_source[idx]) {
+        std::memcpy(source_addr[idx], &src, sizeof(src));
+        have_source[idx] = true;
+        char buf[INET6_ADDRSTRLEN];
+        inet_ntop(AF::family, &src, buf, sizeof(buf));
+        std::cerr << "replay: taking " << buf << " as the scanner address" << std::endl;
+    }
+    return std::memcmp(source_addr[idx], &src, sizeof(src)) == 0;
+}
+
+/**
+ * @brief Builds the lookup key of a probe sent to addr.
+ */
+template <class AF>
+ReplayClassifier::ProbeKey ReplayClassifier::make_key(const typename AF::addr_type &addr, uint16_t src_port,
+                                                      uint16_t dst_port, uint8_t proto) {
+    ProbeKey key;
+    std::memset(&key, 0, sizeof(key));
+    std::memcpy(key.addr, &addr, sizeof(addr));
+    key.src_port = src_port;
+    key.dst_port = dst_port;
+    key.proto = proto;
+    return key;
+}
+
+/**
+ * @brief Counts a frame that is neither a probe nor a reply to one.
+ *
+ * @param why Short reason shown for the first few such frames.
+ */
+void ReplayClassifier::note_unmatched(const char *why) {
+    if (unmatched++ < MAX_UNMATCHED_SHOWN)
+        std::cerr << "replay: frame " << frames << " unmatched (" << why << ")" << std::endl;
+}
+
+/**
+ * @brief Records a probe or classifies a reply for one network-layer packet.
+ *
+ * @param pkt Start of the IP/IPv6 header.
+ * @param len Length of the packet.
+ */
+template <class AF>
+void ReplayClassifier::process(const uint8_t *pkt, size_t len) {
+    uint8_t proto;
+    typename AF::addr_type src, dst;
+    size_t l4_len;
+    const uint8_t *l4 = AF::transport(pkt, len, proto, src, dst, l4_len);
+    if (!l4) {
+        note_unmatched("malformed");
+        return;
+    }
+
+    if (proto == IPPROTO_TCP && l4_len >= sizeof(struct tcphdr)) {
+        const struct tcphdr *tcph = reinterpret_cast<const struct tcphdr*>(l4);
+        if (tcph->syn && !tcph->ack) {
+            if (!from_scanner<AF>(src, dst)) {
+                note_unmatched("tcp syn, not from scanner");
+                return;
+            }
+            ProbeKey key = make_key<AF>(dst, ntohs(tcph->source), ntohs(tcph->dest), IPPROTO_TCP);
+            auto it = probes.find(key);
+            if (it == probes.end()) {
+                char buf[INET6_ADDRSTRLEN];
+                inet_ntop(AF::family, &dst, buf, sizeof(buf));
+                probes.emplace(key, Probe{buf, ntohs(tcph->dest)});
+                order.push_back(key);
+            }
+            probe_frames++;
+            return;
+        }
+        auto it = probes.find(make_key<AF>(src, ntohs(tcph->dest), ntohs(tcph->source), IPPROTO_TCP));
+        if (it == probes.end()) {
+            note_unmatched("tcp, no probe");
+            return;
+        }
+        if (it->second.decided) return;
+        TcpReply reply = classify_tcp_reply<AF>(pkt, len, src, it->first.src_port, it->first.dst_port);
+        if (reply == TcpReply::None) {
+            note_unmatched("tcp, not a reply");
+            return;
+        }
+        it->second.decided = true;
+        report_port(it->second.ip, it->second.port, "tcp", reply == TcpReply::Open ? "open" : "closed");
+        return;
+    }
+
+    if (proto == IPPROTO_UDP && l4_len >= sizeof(struct udphdr)) {
+        const struct udphdr *udph = reinterpret_cast<const struct udphdr*>(l4);
+        if (!from_scanner<AF>(src, dst)) {
+            note_unmatched("udp, not from scanner");
+            return;
+        }
+        ProbeKey key = make_key<AF>(dst, ntohs(udph->source), ntohs(udph->dest), IPPROTO_UDP);
+        if (probes.find(key) == probes.end()) {
+            char buf[INET6_ADDRSTRLEN];
+            inet_ntop(AF::family, &dst, buf, sizeof(buf));
+            probes.emplace(key, Probe{buf, ntohs(udph->dest)});
+            order.push_back(key);
+        }
+        probe_frames++;
+        return;
+    }
+
+    if (proto == AF::icmp_protocol) {
+        typename AF::addr_type quoted_dst;
+        IcmpError err;
+        if (!AF::quoted_destination(l4, l4_len, quoted_dst)) {
+            note_unmatched("icmp, no quote");
+            return;
+        }
+        if (AF::parse_icmp_error(l4, l4_len, IPPROTO_TCP, quoted_dst, err)) {
+            const struct tcphdr *quoted = reinterpret_cast<const struct tcphdr*>(err.quote);
+            auto it = probes.find(make_key<AF>(quoted_dst, ntohs(quoted->source), ntohs(quoted->dest), IPPROTO_TCP));
+            if (it == probes.end()) {
+                note_unmatched("icmp, no probe");
+                return;
+            }
+            if (it->second.decided) return;
+            if (classify_tcp_reply<AF>(pkt, len, quoted_dst, it->first.src_port, it->first.dst_port) ==
+                TcpReply::Filtered) {
+                it->second.decided = true;
+                report_port(it->second.ip, it->second.port, "tcp", "filtered");
+            } else {
+                note_unmatched("icmp, not unreachable");
+            }
+            return;
+        }
+        if (!AF::parse_icmp_error(l4, l4_len, IPPROTO_UDP, quoted_dst, err)) {
+            note_unmatched("icmp, no quoted probe");
+            return;
+        }
+        const struct udphdr *udph = reinterpret_cast<const struct udphdr*>(err.quote);
+        auto it = probes.find(make_key<AF>(quoted_dst, ntohs(udph->source), ntohs(udph->dest), IPPROTO_UDP));
+        if (it == probes.end()) {
+            note_unmatched("icmp, no probe");
+            return;
+        }
+        if (it->second.decided) return;
+        if (err.type == AF::unreach_type && err.code == AF::port_unreach_code) {
+            it->second.decided = true;
+            report_port(it->second.ip, it->second.port, "udp", "closed");
+        } else {
+            note_unmatched("icmp, not port unreachable");
+        }
+        return;
+    }
+
+    note_unmatched("other protocol");
+}
+
+/**
+ * @brief Replays the capture, reports the decided port states and prints replay statistics.
+ *
+ * Probes still undecided at the end of the capture get the state a live scan would give them
+ * on timeout: filtered for TCP, open for UDP. Statistics go to stderr so stdout stays
+ * comparable with a live scan.
+ *
+ * @return true If the capture could be read.
+ */
+bool ReplayClassifier::run() {
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(path.c_str(), errbuf);
+    if (!handle) {
+        std::cerr << "pcap_open_offline: " << errbuf << std::endl;
+        return false;
+    }
+    int link_offset = link_header_length(pcap_datalink(handle));
+    if (link_offset < 0) {
+        std::cerr << "pcap: unsupported datalink type " << pcap_datalink(handle) << std::endl;
+        pcap_close(handle);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    struct pcap_pkthdr *header;
+    const u_char *data;
+    int ret;
+    while ((ret = pcap_next_ex(handle, &header, &data)) == 1) {
+        frames++;
+        if (header->caplen <= static_cast<bpf_u_int32>(link_offset)) {
+            note_unmatched("truncated");
+            continue;
+        }
+        const uint8_t *pkt = data + link_offset;
+        size_t len = header->caplen - link_offset;
+        if ((pkt[0] >> 4) == 4)
+            process<IPv4Family>(pkt, len);
+        else if ((pkt[0] >> 4) == 6)
+            process<IPv6Family>(pkt, len);
+        else
+            note_unmatched("not ip");
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (ret == -1)
+        std::cerr << "pcap_next_ex: " << pcap_geterr(handle) << std::endl;
+    pcap_close(handle);
+
+    uint64_t decided = 0;
+    for (const ProbeKey &key : order) {
+        const Probe &probe = probes[key];
+        if (probe.decided) {
+            decided++;
+            continue;
+        }
+        report_port(probe.ip, probe.port, key.proto == IPPROTO_TCP ? "tcp" : "udp",
+                    key.proto == IPPROTO_TCP ? "filtered" : "open");
+    }
+
+    std::cerr << "replay: " << frames << " frames, " << probe_frames << " probe frames, "
+              << order.size() << " probes (" << decided << " answered), "
+              << unmatched << " unmatched, "
+              << static_cast<uint64_t>(elapsed > 0 ? frames / elapsed : 0) << " frames/s" << std::endl;
+    return ret != -1;
+}
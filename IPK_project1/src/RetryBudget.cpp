@@ -0,0 +1,93 @@
+#include "RetryBudget.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Per-target number of probes per port, adapted to the loss seen so far.
+ *
+ * Loss is estimated from how often a port stays silent on the first probe but answers a
+ * retransmission: p = late / (first + late). The budget is the smallest probe count that
+ * leaves a responsive port undetected with probability below 1 % (p^n < 0.01), clamped to
+ * the configured minimum and maximum. Retransmissions are also counted against the ones that
+ * got an answer: when almost none do (a target whose ports are filtered), the budget falls to
+ * the minimum. While the budget is one probe, every EXPLORE_EVERY-th port still gets a
+ * retransmission so that rising loss is noticed; those are weighted up accordingly.
+ *
+ * @param initial Probe count used until enough answers have been seen.
+ * @param min_count Lower bound for the budget.
+ * @param max_count Upper bound for the budget.
+ */
+RetryBudget::RetryBudget(int initial, int min_count, int max_count)
+    : min_probes(min_count), max_probes(max_count),
+      budget(std::min(max_count, std::max(min_count, initial))) {}
+
+/**
+ * @brief Number of probes to send for the next port at most.
+ *
+ * Returns the budget, or two probes for an exploration port while the budget is one.
+ */
+int RetryBudget::next_limit() {
+    weight = 1;
+    if (budget == 1 && max_probes > 1 && ++explore_tick == EXPLORE_EVERY) {
+        explore_tick = 0;
+        weight = EXPLORE_EVERY;
+        return 2;
+    }
+    return budget;
+}
+
+/**
+ * @brief Records the outcome of the port started with the last next_limit().
+ *
+ * @param answered_on Zero-based attempt that got the answer, -1 if none did.
+ * @param sent Probes actually sent.
+ */
+void RetryBudget::record(int answered_on, int sent) {
+    ports++;
+    probes += sent;
+    if (sent > 1) retries += static_cast<double>(sent - 1) * weight;
+    if (answered_on == 0) first += 1;
+    else if (answered_on > 0) late += weight;
+
+    // Halve old evidence so the estimate follows changing conditions.
+    if (first + late > MAX_EVIDENCE || retries > MAX_EVIDENCE) {
+        first /= 2;
+        late /= 2;
+        retries /= 2;
+    }
+    replan();
+}
+
+/**
+ * @brief Recomputes the budget from the loss estimate and the retransmission yield.
+ *
+ * Silent ports carry no loss information, but their unanswered retransmissions show that
+ * retrying does not pay: once fewer than MIN_YIELD of them get an answer, the budget falls
+ * to the minimum.
+ */
+void RetryBudget::replan() {
+    int needed = budget;
+    if (first + late >= MIN_EVIDENCE) {
+        double loss = late / (first + late);
+        if (loss <= 0)
+            needed = 1;
+        else if (loss >= 1)
+            needed = max_probes;
+        else
+            needed = static_cast<int>(std::ceil(std::log(TARGET_MISS) / std::log(loss)));
+    }
+    if (retries >= MIN_EVIDENCE && late < MIN_YIELD * retries) needed = min_probes;
+    budget = std::min(max_probes, std::max(min_probes, needed));
+}
+
+/**
+ * @brief Prints the loss estimate and the budget to stderr.
+ */
+void RetryBudget::print(const std::string &ip, const char *proto) const {
+    double answered = first + late;
+    std::cerr << ip << " " << proto << " loss " << (answered > 0 ? 100.0 * late / answered : 0.0)
+              << " %, retry yield " << (retries > 0 ? 100.0 * late / retries : 0.0)
+              << " %, " << probes << " probes for " << ports << " ports, budget " << budget
+              << " (" << min_probes << "-" << max_probes << ")" << std::endl;
+}
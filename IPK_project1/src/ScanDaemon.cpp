@@ -0,0 +1,380 @@
+#include "ScanDaemon.hpp"
+#include "PortScanner.hpp"
+#include "TCPScanner.hpp"
+#include "UDPScanner.hpp"
+#include "ConnectScanner.hpp"
+#include "ScanOutput.hpp"
+#include "SocketCache.hpp"
+#include "TopPorts.hpp"
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+ScanDaemon::Client::~Client() {
+    close(fd);
+}
+
+/**
+ * @brief Writes one length-prefixed frame; marks the client dead if the write fails.
+ */
+bool ScanDaemon::Client::send_frame(const std::string &payload) {
+    if (!alive) return false;
+    std::lock_guard<std::mutex> lock(write_mutex);
+    uint32_t len = htonl(static_cast<uint32_t>(payload.size()));
+    std::string frame(reinterpret_cast<const char*>(&len), sizeof(len));
+    frame += payload;
+    size_t off = 0;
+    while (off < frame.size()) {
+        ssize_t n = ::send(fd, frame.data() + off, frame.size() - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            alive = false;
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads exactly len bytes.
+ * @return true On success, false on end of stream or error.
+ */
+static bool read_full(int fd, void *buf, size_t len) {
+    uint8_t *p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends the results of the task running on this worker to the job's client.
+ */
+class JobSink : public ReportSink {
+private:
+    std::function<bool(const std::string &)> emit;
+
+public:
+    explicit JobSink(std::function<bool(const std::string &)> out) : emit(std::move(out)) {}
+    void report(const std::string &line) override { emit(line); }
+};
+
+ScanDaemon::ScanDaemon(const std::string &socket_path, const std::string &iface, int timeout_ms)
+    : path(socket_path), default_iface(iface), default_timeout_ms(timeout_ms),
+      worker_count(std::max(2u, std::thread::hardware_concurrency())) {}
+
+/**
+ * @brief Returns the IPv4 and IPv6 source addresses of an interface, looked up once.
+ */
+std::pair<std::string, std::string> ScanDaemon::interface_addresses(const std::string &iface) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = iface_addrs.find(iface);
+    if (it != iface_addrs.end()) return it->second;
+    auto addrs = std::make_pair(PortScanner::get_ip_from_iface(iface, false),
+                                PortScanner::get_ip_from_iface(iface, true));
+    iface_addrs.emplace(iface, addrs);
+    return addrs;
+}
+
+/**
+ * @brief Parses a job frame into tasks.
+ *
+ * @param text Job text with scanner options and a target.
+ * @param client Connection the job arrived on.
+ * @param error Set to the reason when the job is rejected.
+ * @return std::shared_ptr<Job> The job, or nullptr if it is invalid.
+ */
+std::shared_ptr<ScanDaemon::Job> ScanDaemon::parse_job(const std::string &text, std::shared_ptr<Client> client,
+                                                       std::string &error) {
+    auto job = std::make_shared<Job>();
+    job->id = next_id++;
+    job->client = std::move(client);
+    job->iface = default_iface;
+    job->timeout_ms = default_timeout_ms;
+    job->connect_scan = false;
+
+    std::istringstream in(text);
+    std::string token, target;
+    std::vector<int> tcp_ports, udp_ports;
+    bool ranked = false;
+    try {
+        while (in >> token) {
+            std::string value;
+            bool needs_value = token == "-t" || token == "--pt" || token == "-u" || token == "--pu" ||
+                               token == "-w" || token == "--wait" || token == "-i" || token == "--interface" ||
+                               token == "--top-ports" || token == "--top-udp-ports";
+            if (needs_value && !(in >> value)) {
+                error = "missing value for " + token;
+                return nullptr;
+            }
+            if (token == "-t" || token == "--pt") tcp_ports = PortScanner::parse_ports(value);
+            else if (token == "-u" || token == "--pu") udp_ports = PortScanner::parse_ports(value);
+            else if (token == "-w" || token == "--wait") job->timeout_ms = std::stoi(value);
+            else if (token == "-i" || token == "--interface") job->iface = value;
+            else if (token == "-c" || token == "--connect") job->connect_scan = true;
+            else if (token == "--top-ports" || token == "--top-udp-ports") {
+                int count = std::stoi(value);
+                if (count < 1 || count > 65535) {
+                    error = "top port count out of range";
+                    return nullptr;
+                }
+                (token == "--top-ports" ? tcp_ports : udp_ports) = top_ports(token != "--top-ports", count);
+            }
+            else if (token == "--rank-order") ranked = true;
+            else if (token[0] == '-') {
+                error = "unknown option " + token;
+                return nullptr;
+            } else target = token;
+        }
+    } catch (const std::exception &) {
+        error = "invalid number";
+        return nullptr;
+    }
+    if (target.empty()) {
+        error = "no target";
+        return nullptr;
+    }
+    if (tcp_ports.empty() && udp_ports.empty()) {
+        error = "no ports";
+        return nullptr;
+    }
+    if (ranked) {
+        rank_order(tcp_ports, false);
+        rank_order(udp_ports, true);
+    }
+    if (job->iface.empty()) {
+        error = "no interface";
+        return nullptr;
+    }
+    auto sources = interface_addresses(job->iface);
+    if (sources.first.empty() && sources.second.empty()) {
+        error = "no usable source address on " + job->iface;
+        return nullptr;
+    }
+    std::vector<std::string> addrs = PortScanner::resolve_hostname(target);
+    if (addrs.empty()) {
+        error = "cannot resolve " + target;
+        return nullptr;
+    }
+
+    for (const std::string &ip : addrs) {
+        bool is_ipv6 = ip.find(':') != std::string::npos;
+        const std::string &src = is_ipv6 ? sources.second : sources.first;
+        if (src.empty()) continue;
+        for (int udp = 0; udp < 2; udp++) {
+            const std::vector<int> &ports = udp ? udp_ports : tcp_ports;
+            for (size_t i = 0; i < ports.size(); i += TASK_PORTS) {
+                size_t end = std::min(ports.size(), i + TASK_PORTS);
+                job->tasks.push_back(Task{ip, src, udp == 1,
+                                          std::vector<int>(ports.begin() + i, ports.begin() + end)});
+            }
+        }
+    }
+    if (job->tasks.empty()) {
+        error = "no source address for the target's address family";
+        return nullptr;
+    }
+    job->remaining = job->tasks.size();
+    return job;
+}
+
+/**
+ * @brief Reads job frames from one client and queues them.
+ *
+ * The connection stays open after the client stops sending until its jobs are done.
+ */
+void ScanDaemon::client_loop(std::shared_ptr<Client> client) {
+    while (true) {
+        uint32_t len;
+        if (!read_full(client->fd, &len, sizeof(len))) break;
+        len = ntohl(len);
+        if (len > MAX_FRAME) {
+            client->send_frame("0 error frame too large");
+            break;
+        }
+        std::string text(len, '\0');
+        if (!read_full(client->fd, &text[0], len)) break;
+
+        std::string error;
+        std::shared_ptr<Job> job = parse_job(text, client, error);
+        if (!job) {
+            client->send_frame("0 error " + error);
+            continue;
+        }
+        client->send_frame(std::to_string(job->id) + " accepted");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(job);
+        }
+        ready_cv.notify_one();
+    }
+    client->reading = false;
+}
+
+/**
+ * @brief Runs one task with this worker's cached sockets, streaming results to the client.
+ */
+void ScanDaemon::run_task(Job &job, const Task &task, SocketCache &cache) {
+    std::string prefix = std::to_string(job.id) + " ";
+    std::shared_ptr<Client> client = job.client;
+    JobSink sink([&](const std::string &line) { return client->send_frame(prefix + line); });
+    set_thread_report_sink(&sink);
+    if (task.udp) {
+        UDPScanner udp(task.ip, task.ports, job.timeout_ms);
+        udp.use_cache(&cache);
+        udp.scan();
+    } else {
+        TCPScanner tcp(job.iface, task.ip, task.src, task.ports, job.timeout_ms);
+        tcp.use_cache(&cache);
+        if (job.connect_scan || !tcp.scan()) {
+            ConnectScanner conn(task.ip, task.src, task.ports, job.timeout_ms);
+            conn.scan();
+        }
+    }
+    set_thread_report_sink(nullptr);
+}
+
+/**
+ * @brief Takes tasks round-robin from the active jobs until the daemon stops.
+ *
+ * A job goes back to the end of the queue after each task it hands out. Remaining tasks of a
+ * job whose client has disconnected are dropped.
+ */
+void ScanDaemon::worker_loop() {
+    SocketCache cache;
+    while (true) {
+        std::shared_ptr<Job> job;
+        const Task *task = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready_cv.wait(lock, [this] { return stopping || !ready.empty(); });
+            if (stopping) return;
+            job = ready.front();
+            ready.pop_front();
+            task = &job->tasks[job->next_task++];
+            if (job->next_task < job->tasks.size()) {
+                ready.push_back(job);
+                ready_cv.notify_one();
+            }
+        }
+        if (job->client->alive) run_task(*job, *task, cache);
+        if (--job->remaining == 0)
+            job->client->send_frame(std::to_string(job->id) + " done");
+    }
+}
+
+/**
+ * @brief Checks that the socket path may be taken, removing a stale socket left there.
+ *
+ * @return false If the path is some other file or a daemon is still listening on it.
+ */
+static bool claim_socket_path(const sockaddr_un &addr) {
+    struct stat st;
+    if (lstat(addr.sun_path, &st) < 0) return errno == ENOENT;
+    if (!S_ISSOCK(st.st_mode)) {
+        std::cerr << addr.sun_path << " exists and is not a socket" << std::endl;
+        return false;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        perror("socket");
+        return false;
+    }
+    bool in_use = connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(probe);
+    if (in_use) {
+        std::cerr << "A daemon is already listening on " << addr.sun_path << std::endl;
+        return false;
+    }
+    unlink(addr.sun_path);
+    return true;
+}
+
+/**
+ * @brief Listens and serves clients until the process is stopped.
+ *
+ * Worker and client threads are joined before returning: readers are woken by shutting their
+ * connections down, workers finish the task they are running and drop the rest.
+ *
+ * @return false If the socket could not be set up or accepting failed.
+ */
+bool ScanDaemon::serve() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    if (!claim_socket_path(addr)) return false;
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        perror("socket");
+        return false;
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        close(listener);
+        return false;
+    }
+    if (listen(listener, 64) < 0) {
+        perror("listen");
+        close(listener);
+        return false;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < worker_count; i++)
+        workers.emplace_back(&ScanDaemon::worker_loop, this);
+    std::cerr << "Listening on " << path << " with " << worker_count << " workers" << std::endl;
+
+    std::vector<std::pair<std::thread, std::shared_ptr<Client>>> readers;
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+        // Join the readers of connections that have stopped sending.
+        for (auto it = readers.begin(); it != readers.end();) {
+            if (it->second->reading) {
+                ++it;
+                continue;
+            }
+            it->first.join();
+            it = readers.erase(it);
+        }
+        auto client = std::make_shared<Client>(fd);
+        readers.emplace_back(std::thread(&ScanDaemon::client_loop, this, client), client);
+    }
+    close(listener);
+
+    for (auto &reader : readers) {
+        shutdown(reader.second->fd, SHUT_RDWR);
+        reader.first.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        ready.clear();
+    }
+    ready_cv.notify_all();
+    for (std::thread &worker : workers) worker.join();
+    return false;
+}
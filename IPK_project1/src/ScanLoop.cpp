@@ -0,0 +1,408 @@
+#include "ScanLoop.hpp"
+#include "PacketSource.hpp"
+#include "PcapRecorder.hpp"
+#include "Timing.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Frees the finished coroutine and tells its loop that a task slot is free.
+ */
+void ScanTask::FinalAwaiter::await_suspend(handle_type h) noexcept {
+    ScanLoop *loop = h.promise().loop;
+    h.destroy();
+    loop->finished();
+}
+
+/**
+ * @brief FNV-1a over the fields of the key.
+ */
+size_t ReplyKeyHash::operator()(const ReplyKey &key) const {
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&](const void *data, size_t len) {
+        const uint8_t *p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; i++) hash = (hash ^ p[i]) * 1099511628211ull;
+    };
+    add(&key.family, sizeof(key.family));
+    add(&key.proto, sizeof(key.proto));
+    add(&key.remote_port, sizeof(key.remote_port));
+    add(&key.local_port, sizeof(key.local_port));
+    add(key.addr, sizeof(key.addr));
+    return static_cast<size_t>(hash);
+}
+
+/**
+ * @brief Creates the loop; sockets are opened by the first task of each kind.
+ *
+ * @param interface Interface for the IPv6 TCP capture.
+ * @param src Local IPv4 address ("" if none).
+ * @param src6 Local IPv6 address ("" if none).
+ */
+ScanLoop::ScanLoop(const std::string &interface, const std::string &src, const std::string &src6)
+    : iface(interface) {
+    if (!IPv4Family::parse(src, src4)) tcp_failed[0] = udp_failed[0] = true;
+    if (!IPv6Family::parse(src6, this->src6)) tcp_failed[1] = udp_failed[1] = true;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        tcp_failed[0] = tcp_failed[1] = udp_failed[0] = udp_failed[1] = true;
+    }
+}
+
+/**
+ * @brief Frees tasks that never started; sockets are closed by the cache.
+ */
+ScanLoop::~ScanLoop() {
+    for (auto h : queued) h.destroy();
+    if (epfd >= 0) close(epfd);
+}
+
+/**
+ * @brief Returns the index of a descriptor's entry, adding it to the epoll set if new.
+ */
+size_t ScanLoop::track(int fd) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i].fd == fd) return i;
+    }
+    Source source;
+    source.fd = fd;
+    sources.push_back(source);
+    struct epoll_event ev{};
+    ev.data.u32 = static_cast<uint32_t>(sources.size() - 1);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    return sources.size() - 1;
+}
+
+/**
+ * @brief Applies the events wanted for an entry to the epoll set.
+ */
+void ScanLoop::update(size_t index) {
+    struct epoll_event ev{};
+    ev.events = sources[index].events;
+    ev.data.u32 = static_cast<uint32_t>(index);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, sources[index].fd, &ev);
+}
+
+/**
+ * @brief Starts reading packets from a descriptor.
+ *
+ * @param fd Socket or capture descriptor.
+ * @param family Address family of the packets it delivers.
+ * @param capture Capture to read from, nullptr for a raw socket.
+ */
+void ScanLoop::watch(int fd, int family, PacketSource *capture) {
+    size_t index = track(fd);
+    if (sources[index].receives) return;
+    if (!capture) {
+        // Replies from all targets share the socket and arrive in bursts when tasks start together.
+        int size = 8 << 20;
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        enable_rx_timestamps(fd);
+    }
+    sources[index].family = family;
+    sources[index].capture = capture;
+    sources[index].receives = true;
+    sources[index].events |= EPOLLIN;
+    update(index);
+}
+
+/**
+ * @brief Makes a probe socket non-blocking with a large send buffer.
+ *
+ * All tasks share the socket; packets queued behind unresolved neighbours hold buffer space
+ * for seconds, so the default size would stall the loop early.
+ */
+static void prepare_send_socket(int sock) {
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    int size = 4 << 20;
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDBUFFORCE, &size, sizeof(size)) < 0)
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+/**
+ * @brief Opens the raw TCP probe socket and reply source of a family.
+ *
+ * IPv4 replies arrive on the probe socket itself and ICMP errors on a raw ICMP socket;
+ * IPv6 replies and errors come from the capture on the interface.
+ *
+ * @param family AF_INET or AF_INET6.
+ * @return true If TCP tasks of that family can run in the loop.
+ */
+bool ScanLoop::open_tcp(int family) {
+    int i = family == AF_INET6;
+    if (tcp_send[i] >= 0) return true;
+    if (tcp_failed[i]) return false;
+    int sock = i ? sockets.tcp_socket(src6) : sockets.tcp_socket(src4);
+    PacketSource *capture = nullptr;
+    if (sock >= 0 && i) capture = sockets.tcp6_capture(iface);
+    if (sock < 0 || (i && !capture)) {
+        tcp_failed[i] = true;
+        return false;
+    }
+    prepare_send_socket(sock);
+    if (i) {
+        watch(capture->fd(), AF_INET6, capture);
+    } else {
+        watch(sock, AF_INET, nullptr);
+        int icmp = sockets.icmp_socket(AF_INET);
+        if (icmp >= 0) watch(icmp, AF_INET, nullptr);
+    }
+    tcp_send[i] = sock;
+    return true;
+}
+
+/**
+ * @brief Opens the UDP probe socket and ICMP socket of a family.
+ *
+ * The probe socket is bound at once so that its port is known before the first reply.
+ *
+ * @param family AF_INET or AF_INET6.
+ * @return true If UDP tasks of that family can run in the loop.
+ */
+bool ScanLoop::open_udp(int family) {
+    int i = family == AF_INET6;
+    if (udp_send[i] >= 0) return true;
+    if (udp_failed[i]) return false;
+    int sock = sockets.udp_socket(family);
+    int icmp = sockets.icmp_socket(family);
+    sockaddr_storage name{};
+    socklen_t name_len = i ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    name.ss_family = static_cast<sa_family_t>(family);
+    if (sock < 0 || icmp < 0 || bind(sock, reinterpret_cast<sockaddr*>(&name), name_len) < 0 ||
+        getsockname(sock, reinterpret_cast<sockaddr*>(&name), &name_len) < 0) {
+        udp_failed[i] = true;
+        return false;
+    }
+    // sin_port and sin6_port share their offset.
+    udp_port[i] = ntohs(reinterpret_cast<sockaddr_in*>(&name)->sin_port);
+    prepare_send_socket(sock);
+    watch(icmp, family, nullptr);
+    udp_send[i] = sock;
+    return true;
+}
+
+/**
+ * @brief Queues a task; it starts as soon as fewer than MAX_RUNNING tasks are in progress.
+ */
+void ScanLoop::spawn(ScanTask task) {
+    task.handle.promise().loop = this;
+    queued.push_back(task.handle);
+    task.handle = nullptr;
+}
+
+/**
+ * @brief Awaitable send of a complete IP/IPv6 TCP packet through the raw socket of its family.
+ */
+SendProbe ScanLoop::send_tcp(int family, const void *pkt, size_t len, const sockaddr_storage &dst,
+                             socklen_t dst_len) {
+    return SendProbe(*this, tcp_send[family == AF_INET6], pkt, len, dst, dst_len);
+}
+
+/**
+ * @brief Awaitable send of an empty UDP datagram to a port.
+ */
+SendProbe ScanLoop::send_udp(const sockaddr_storage &dst, socklen_t dst_len) {
+    return SendProbe(*this, udp_send[dst.ss_family == AF_INET6], nullptr, 0, dst, dst_len);
+}
+
+/**
+ * @brief Sends a packet if the socket buffer has room.
+ *
+ * Errors other than a full buffer count as sent: the probe is lost, as it would be on the
+ * wire, and the wait for its reply times out.
+ *
+ * @return true If the packet is done with; false if the buffer is full.
+ */
+bool ScanLoop::try_send(int fd, const void *pkt, size_t len, const sockaddr_storage &dst, socklen_t dst_len) {
+    ssize_t n = sendto(fd, pkt, len, 0, reinterpret_cast<const sockaddr*>(&dst), dst_len);
+    return n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS);
+}
+
+/**
+ * @brief Suspends a task until a send socket has room again (EPOLLOUT).
+ */
+void ScanLoop::wait_writable(PendingWait &pending, std::coroutine_handle<> h, int fd) {
+    pending.handle = h;
+    size_t index = track(fd);
+    sources[index].blocked.push_back(&pending);
+    if (!(sources[index].events & EPOLLOUT)) {
+        sources[index].events |= EPOLLOUT;
+        update(index);
+    }
+}
+
+/**
+ * @brief Resumes every task blocked on a send socket that has room again.
+ */
+void ScanLoop::release(size_t index) {
+    std::vector<PendingWait*> ready;
+    ready.swap(sources[index].blocked);
+    sources[index].events &= ~EPOLLOUT;
+    update(index);
+    for (PendingWait *pending : ready) pending->handle.resume();
+}
+
+/**
+ * @brief Registers a suspended wait, under its key if it has one, with a timeout.
+ *
+ * A second wait under the same key (the same address listed twice) takes over delivery;
+ * the first one still ends at its timeout.
+ */
+void ScanLoop::wait(PendingWait &pending, std::coroutine_handle<> h, int timeout_ms) {
+    pending.handle = h;
+    pending.answered = false;
+    if (pending.keyed) waiting[pending.key] = &pending;
+    pending.timer = timers.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms),
+                                   &pending);
+}
+
+/**
+ * @brief Extracts the key of the probe a received packet concerns.
+ *
+ * TCP segments are keyed by their source (the target) and ports; ICMP errors by the
+ * destination and ports of the TCP or UDP packet they quote.
+ *
+ * @return true If the packet can answer a probe.
+ */
+template <class AF>
+static bool packet_key(const uint8_t *pkt, size_t len, ReplyKey &key) {
+    uint8_t proto;
+    typename AF::addr_type src, dst;
+    size_t l4_len;
+    const uint8_t *l4 = AF::transport(pkt, len, proto, src, dst, l4_len);
+    if (!l4) return false;
+    if (proto == IPPROTO_TCP) {
+        if (l4_len < sizeof(struct tcphdr)) return false;
+        const struct tcphdr *tcph = reinterpret_cast<const struct tcphdr*>(l4);
+        key = reply_key<AF>(IPPROTO_TCP, src, ntohs(tcph->source), ntohs(tcph->dest));
+        return true;
+    }
+    typename AF::addr_type quoted;
+    if (proto != AF::icmp_protocol || !AF::quoted_destination(l4, l4_len, quoted)) return false;
+    for (uint8_t inner : {static_cast<uint8_t>(IPPROTO_TCP), static_cast<uint8_t>(IPPROTO_UDP)}) {
+        IcmpError err;
+        if (!AF::parse_icmp_error(l4, l4_len, inner, quoted, err)) continue;
+        // Both transports start with the source and destination port.
+        const struct udphdr *ports = reinterpret_cast<const struct udphdr*>(err.quote);
+        key = reply_key<AF>(inner, quoted, ntohs(ports->dest), ntohs(ports->source));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Hands a received packet to the task waiting for it, if any, and resumes that task.
+ *
+ * Packets delivered to a task are also passed to the pcap recorder.
+ */
+void ScanLoop::dispatch(const uint8_t *pkt, size_t len, int family, const timespec &stamp) {
+    ReplyKey key;
+    bool ok = family == AF_INET6 ? packet_key<IPv6Family>(pkt, len, key) : packet_key<IPv4Family>(pkt, len, key);
+    if (!ok) return;
+    auto it = waiting.find(key);
+    if (it == waiting.end()) return;
+    PendingWait *pending = it->second;
+    record_packet(pkt, len, stamp);
+    if (!pending->offer(pkt, len)) return;
+    waiting.erase(it);
+    timers.erase(pending->timer);
+    pending->answered = true;
+    pending->stamp = stamp;
+    pending->handle.resume();
+}
+
+/**
+ * @brief Reads every packet already queued on a source.
+ *
+ * The ICMPv6 socket delivers messages without the IPv6 header; one is put back in front so
+ * that all packets reach dispatch() in the same form.
+ */
+void ScanLoop::drain(size_t index) {
+    // Tasks resumed from dispatch() may add entries, so the entry is not held by reference.
+    int fd = sources[index].fd;
+    int family = sources[index].family;
+    PacketSource *capture = sources[index].capture;
+    timespec stamp;
+    if (capture) {
+        const uint8_t *pkt;
+        ssize_t n;
+        while ((n = capture->next(pkt, 0, &stamp)) >= 0) dispatch(pkt, n, family, stamp);
+        return;
+    }
+    const size_t l3_len = sizeof(struct ip6_hdr);
+    uint8_t buf[l3_len + 2048];
+    while (true) {
+        sockaddr_storage from;
+        ssize_t n = recv_stamped(fd, buf + l3_len, sizeof(buf) - l3_len, &stamp, MSG_DONTWAIT, &from);
+        if (n < 0) return;
+        if (family == AF_INET) {
+            dispatch(buf + l3_len, n, AF_INET, stamp);
+        } else {
+            IPv6Family::write_header(buf, reinterpret_cast<sockaddr_in6*>(&from)->sin6_addr, src6,
+                                     IPPROTO_ICMPV6, n);
+            dispatch(buf, l3_len + n, AF_INET6, stamp);
+        }
+    }
+}
+
+/**
+ * @brief Milliseconds until the earliest timer expires, -1 if there is none.
+ */
+int ScanLoop::next_timeout() const {
+    if (timers.empty()) return -1;
+    auto left = timers.begin()->first - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero()) return 0;
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(left).count());
+}
+
+/**
+ * @brief Resumes every task whose timeout has passed.
+ */
+void ScanLoop::expire() {
+    auto now = std::chrono::steady_clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        PendingWait *pending = timers.begin()->second;
+        timers.erase(timers.begin());
+        if (pending->keyed) {
+            auto it = waiting.find(pending->key);
+            if (it != waiting.end() && it->second == pending) waiting.erase(it);
+        }
+        pending->handle.resume();
+    }
+}
+
+/**
+ * @brief Runs until every spawned task has finished.
+ *
+ * Each round starts queued tasks while slots are free, waits for packets, send buffer space
+ * or the next timeout, resumes the tasks concerned and then the expired waits.
+ */
+void ScanLoop::run() {
+    struct epoll_event events[64];
+    while (true) {
+        while (running < MAX_RUNNING && !queued.empty()) {
+            ScanTask::handle_type h = queued.front();
+            queued.pop_front();
+            running++;
+            h.resume();
+        }
+        if (running == 0) {
+            if (queued.empty()) break;
+            continue;
+        }
+        int n = epoll_wait(epfd, events, 64, next_timeout());
+        for (int i = 0; i < n; i++) {
+            size_t index = events[i].data.u32;
+            if (events[i].events & EPOLLOUT) release(index);
+            if (sources[index].receives && (events[i].events & (EPOLLIN | EPOLLERR))) drain(index);
+        }
+        expire();
+    }
+}
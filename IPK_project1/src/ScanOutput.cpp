@@ -0,0 +1,124 @@
+#include "ScanOutput.hpp"
+#include "BannerGrabber.hpp"
+#include "ScanSummary.hpp"
+#include <mutex>
+#include <cstring>
+
+static std::mutex output_mutex;
+static Baseline *report_baseline = nullptr;
+static StateDb *report_db = nullptr;
+static BannerGrabber *report_banners = nullptr;
+static ScanSummary *report_summary = nullptr;
+static thread_local ReportSink *thread_sink = nullptr;
+
+/**
+ * @brief Prints the state of a single scanned port in the common output format.
+ *
+ * Safe to call from concurrently running scans; each line is written whole.
+ * Database stores bypass the lock because every job writes its own state array.
+ * Open TCP ports only get queued for the banner stage, so the caller never waits for it.
+ * In summary mode only open ports are printed; the rest is aggregated for the end of the scan.
+ *
+ * @param ip Target IP address.
+ * @param port Scanned port.
+ * @param proto Protocol name ("tcp" or "udp").
+ * @param state Port state ("open", "closed" or "filtered").
+ */
+void report_port(const std::string &ip, int port, const char *proto, const char *state) {
+    if (thread_sink) {
+        thread_sink->report(ip + " " + std::to_string(port) + " " + proto + " " + state);
+        return;
+    }
+    if (report_db) {
+        report_db->record(ip, port, proto, state);
+        if (!report_baseline) return;
+    }
+    if (report_summary && !report_baseline) {
+        report_summary->record(ip, port, proto, state);
+        if (std::strcmp(state, "open") != 0) return;
+    }
+    if (report_banners && !report_baseline && std::strcmp(proto, "tcp") == 0 && std::strcmp(state, "open") == 0) {
+        report_banners->submit(ip, port);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (report_baseline) {
+        Baseline::State old = report_baseline->update(ip, port, proto, state);
+        if (old == Baseline::parse_state(state)) return;
+        std::cout << ip << " " << port << " " << proto << " " << Baseline::name(old)
+                  << " -> " << state << std::endl;
+        return;
+    }
+    std::cout << ip << " " << port << " " << proto << " " << state << std::endl;
+}
+
+/**
+ * @brief Prints an open TCP port together with the banner read from it.
+ *
+ * @param ip Target IP address.
+ * @param port Open port.
+ * @param banner Printable first line sent by the service, may be empty.
+ */
+void report_open_banner(const std::string &ip, int port, const std::string &banner) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << ip << " " << port << " tcp open";
+    if (!banner.empty()) std::cout << " " << banner;
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Switches report_port() to diff output against a previous scan.
+ *
+ * Must be called before any scan starts.
+ *
+ * @param baseline Baseline updated with every result, or nullptr for plain output.
+ */
+void set_report_baseline(Baseline *baseline) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    report_baseline = baseline;
+}
+
+/**
+ * @brief Sends results to a port-state database instead of stdout.
+ *
+ * Must be called before any scan starts.
+ *
+ * @param db Open database, or nullptr for line output.
+ */
+void set_report_database(StateDb *db) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    report_db = db;
+}
+
+/**
+ * @brief Routes the results reported on the calling thread to a sink.
+ *
+ * @param sink Sink for this thread, or nullptr to restore the global output.
+ */
+void set_thread_report_sink(ReportSink *sink) {
+    thread_sink = sink;
+}
+
+/**
+ * @brief Hands open TCP ports in line output to a banner-grabbing stage.
+ *
+ * Must be called before any scan starts; the stage has to be closed before it is unset.
+ *
+ * @param grabber Running stage, or nullptr to print open ports directly.
+ */
+void set_report_banners(BannerGrabber *grabber) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    report_banners = grabber;
+}
+
+/**
+ * @brief Collects closed and filtered results in a summary instead of printing them.
+ *
+ * Must be called before any scan starts.
+ *
+ * @param summary Summary printed by the caller when the scan ends, or nullptr for full output.
+ */
+void set_report_summary(ScanSummary *summary) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    report_summary = summary;
+}
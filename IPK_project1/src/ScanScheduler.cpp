@@ -0,0 +1,33 @@
+#include "ScanScheduler.hpp"
+
+/**
+ * @brief Queues a job to be started by run().
+ *
+ * @param job Callable performing one complete scan.
+ */
+void ScanScheduler::add(std::function<void()> job) {
+    jobs.push_back(std::move(job));
+}
+
+/**
+ * @brief Starts all queued jobs at once and blocks until every one has returned.
+ *
+ * Scans spend nearly all their time waiting for replies, so every job gets its own thread;
+ * a single job runs on the calling thread.
+ */
+void ScanScheduler::run() {
+    if (jobs.size() == 1) {
+        jobs.front()();
+        jobs.clear();
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(jobs.size());
+    for (auto &job : jobs) {
+        workers.emplace_back(job);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    jobs.clear();
+}
@@ -0,0 +1,69 @@
+#include "ScanSummary.hpp"
+
+static const size_t PORT_COUNT = 65536;
+
+/**
+ * @brief Records one result.
+ *
+ * @param ip Target address.
+ * @param port Scanned port.
+ * @param proto "tcp" or "udp".
+ * @param state "open", "closed" or "filtered".
+ */
+void ScanSummary::record(const std::string &ip, int port, const char *proto, const char *state) {
+    if (port < 0 || port >= static_cast<int>(PORT_COUNT)) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint8_t> &states = hosts[{ip, proto}];
+    if (states.empty()) states.assign(PORT_COUNT, Baseline::UNKNOWN);
+    states[port] = Baseline::parse_state(state);
+}
+
+/**
+ * @brief Formats the ports in a given state as comma-separated runs of consecutive ports.
+ *
+ * @param states State of every port.
+ * @param wanted State to list.
+ * @param count Set to the number of ports in that state.
+ * @return std::string Runs such as "1-21,23-79", empty if there are none.
+ */
+static std::string port_runs(const std::vector<uint8_t> &states, uint8_t wanted, uint64_t &count) {
+    std::string runs;
+    count = 0;
+    size_t port = 0;
+    while (port < states.size()) {
+        if (states[port] != wanted) {
+            port++;
+            continue;
+        }
+        size_t first = port;
+        while (port < states.size() && states[port] == wanted) port++;
+        count += port - first;
+        if (!runs.empty()) runs += ',';
+        runs += std::to_string(first);
+        if (port - 1 > first) runs += '-' + std::to_string(port - 1);
+    }
+    return runs;
+}
+
+/**
+ * @brief Prints the closed and filtered runs and the counts of every host and protocol.
+ *
+ * @param out Stream to write to.
+ */
+void ScanSummary::print(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &entry : hosts) {
+        const std::string &ip = entry.first.first;
+        const std::string &proto = entry.first.second;
+        const std::vector<uint8_t> &states = entry.second;
+        uint64_t open = 0, closed = 0, filtered = 0;
+        for (uint8_t s : states) open += s == Baseline::OPEN;
+        std::string closed_runs = port_runs(states, Baseline::CLOSED, closed);
+        std::string filtered_runs = port_runs(states, Baseline::FILTERED, filtered);
+        if (!closed_runs.empty()) out << ip << " " << proto << " closed " << closed_runs << "\n";
+        if (!filtered_runs.empty()) out << ip << " " << proto << " filtered " << filtered_runs << "\n";
+        out << ip << " " << proto << " " << open << " open, " << closed << " closed, "
+            << filtered << " filtered" << "\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,100 @@
+#include "ShardPlan.hpp"
+
+/**
+ * @brief splitmix64 finalizer, used for the round keys and the round function.
+ */
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Keyed pseudo-random permutation of [0, size).
+ *
+ * A four-round Feistel network over the smallest even number of bits that covers the domain,
+ * with cycle walking for values past the end. The same size and seed give the same permutation
+ * on every machine, so scanner nodes agree on the order without talking to each other.
+ *
+ * @param size Number of elements.
+ * @param seed Key shared by all nodes of a sharded scan.
+ */
+ShardPermutation::ShardPermutation(uint64_t size, uint64_t seed) : size(size) {
+    int bits = 2;
+    while (bits < 64 && (1ULL << bits) < size) bits += 2;
+    half_bits = bits / 2;
+    half_mask = (1ULL << half_bits) - 1;
+    uint64_t state = seed;
+    for (int i = 0; i < ROUNDS; i++) {
+        state = mix(state);
+        keys[i] = state;
+    }
+}
+
+/**
+ * @brief One pass of the Feistel network over the full power-of-two domain.
+ */
+uint64_t ShardPermutation::encrypt(uint64_t value) const {
+    uint64_t left = value >> half_bits;
+    uint64_t right = value & half_mask;
+    for (int i = 0; i < ROUNDS; i++) {
+        uint64_t next = left ^ (mix(right ^ keys[i]) & half_mask);
+        left = right;
+        right = next;
+    }
+    return (left << half_bits) | right;
+}
+
+/**
+ * @brief Element at a position of the permutation.
+ *
+ * Values outside [0, size) are encrypted again until they fall inside (cycle walking), which
+ * keeps the mapping a bijection; the domain is less than four times the size, so this ends
+ * after a few rounds on average.
+ *
+ * @param index Position, less than the size.
+ * @return uint64_t The permuted element.
+ */
+uint64_t ShardPermutation::at(uint64_t index) const {
+    uint64_t value = encrypt(index);
+    while (value >= size) value = encrypt(value);
+    return value;
+}
+
+/**
+ * @brief Parses a shard specification "i/N".
+ *
+ * @param spec Text from the command line, with 1 <= i <= N.
+ * @return true If the specification is valid; index is stored zero-based.
+ */
+bool ShardSpec::parse(const std::string &spec) {
+    size_t slash = spec.find('/');
+    if (slash == std::string::npos) return false;
+    try {
+        long i = std::stol(spec.substr(0, slash));
+        long n = std::stol(spec.substr(slash + 1));
+        if (n < 1 || i < 1 || i > n) return false;
+        index = static_cast<unsigned>(i - 1);
+        count = static_cast<unsigned>(n);
+    } catch (const std::exception &) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Visits the elements of this shard in permutation order.
+ *
+ * A shard is the slice of a scan taken by one node: positions index, index + count, ... of
+ * the permutation. Shards take interleaved positions of one permutation, so N shards with the same seed cover
+ * [0, size) exactly once between them and each one is spread over the whole space.
+ *
+ * @param size Number of elements in the whole scan.
+ * @param visit Called once per element of the shard.
+ */
+void ShardSpec::walk(uint64_t size, const std::function<void(uint64_t)> &visit) const {
+    ShardPermutation perm(size, seed);
+    for (uint64_t position = index; position < size; position += count)
+        visit(perm.at(position));
+}
@@ -0,0 +1,68 @@
+#include "SocketCache.hpp"
+#include "TCPScanner.hpp"
+#include <unistd.h>
+#include <sys/socket.h>
+
+SocketCache::~SocketCache() {
+    if (tcp4 >= 0) close(tcp4);
+    for (auto &entry : tcp6) close(entry.second);
+    for (int i = 0; i < 2; i++) {
+        if (udp[i] >= 0) close(udp[i]);
+        if (icmp[i] >= 0) close(icmp[i]);
+    }
+}
+
+/**
+ * @brief Raw TCP probe socket for IPv4, opened on first use.
+ */
+int SocketCache::tcp_socket(const in_addr &src) {
+    if (tcp4 < 0) tcp4 = open_raw_socket(src);
+    return tcp4;
+}
+
+/**
+ * @brief Raw probe socket for IPv6 bound to src, opened on first use.
+ */
+int SocketCache::tcp_socket(const in6_addr &src) {
+    std::string key(reinterpret_cast<const char*>(&src), sizeof(src));
+    auto it = tcp6.find(key);
+    if (it != tcp6.end()) return it->second;
+    int sock = open_raw_socket(src);
+    if (sock >= 0) tcp6.emplace(key, sock);
+    return sock;
+}
+
+/**
+ * @brief Capture of all IPv6 TCP traffic on an interface, opened on first use.
+ *
+ * The filter carries no host so that the capture serves every target; ICMPv6 errors are
+ * included for the unreachable classification.
+ */
+PacketSource *SocketCache::tcp6_capture(const std::string &iface) {
+    auto it = captures6.find(iface);
+    if (it != captures6.end()) return it->second.get();
+    std::unique_ptr<PcapSource> capture = PcapSource::open_live(iface, "ip6 and (tcp or icmp6)");
+    if (!capture) return nullptr;
+    return captures6.emplace(iface, std::move(capture)).first->second.get();
+}
+
+/**
+ * @brief Unconnected UDP socket for sending probes, opened on first use.
+ */
+int SocketCache::udp_socket(int family) {
+    int &sock = udp[family == AF_INET6];
+    if (sock < 0) sock = socket(family, SOCK_DGRAM, 0);
+    return sock;
+}
+
+/**
+ * @brief Raw ICMP/ICMPv6 socket for receiving port-unreachable errors, opened on first use.
+ */
+int SocketCache::icmp_socket(int family) {
+    int &sock = icmp[family == AF_INET6];
+    if (sock < 0) {
+        int proto = family == AF_INET6 ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP);
+        sock = socket(family, SOCK_RAW, proto);
+    }
+    return sock;
+}
@@ -0,0 +1,154 @@
+#include "StateDb.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+static const char DB_MAGIC[8] = {'I', 'P', 'K', 'S', 'D', 'B', '1', '\0'};
+static const uint32_t DB_VERSION = 1;
+static const size_t PAGE = 4096;
+
+StateDb::~StateDb() {
+    if (base) {
+        if (writable) msync(base, length, MS_ASYNC);
+        munmap(base, length);
+    }
+    if (fd >= 0) close(fd);
+}
+
+/**
+ * @brief Maps the file and sets up the header, index and data pointers.
+ */
+bool StateDb::map(int file, size_t len, bool rw) {
+    fd = file;
+    length = len;
+    writable = rw;
+    void *p = mmap(nullptr, len, rw ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+    base = static_cast<uint8_t*>(p);
+    header = reinterpret_cast<const StateDbHeader*>(base);
+    hosts = reinterpret_cast<const StateDbHost*>(base + sizeof(StateDbHeader));
+    return true;
+}
+
+/**
+ * @brief Creates (or truncates) a database sized for the given hosts.
+ *
+ * The file is extended with ftruncate(), so untouched state arrays stay sparse and read as
+ * UNSCANNED. The address lookup used by record() is built here, once.
+ *
+ * @param path Database file.
+ * @param addrs Host addresses, in the order they get their index entries.
+ * @return std::unique_ptr<StateDb> nullptr on failure (error already printed).
+ */
+std::unique_ptr<StateDb> StateDb::create(const std::string &path, const std::vector<std::string> &addrs) {
+    size_t index_end = sizeof(StateDbHeader) + addrs.size() * sizeof(StateDbHost);
+    size_t data_offset = (index_end + PAGE - 1) / PAGE * PAGE;
+    size_t total = data_offset + addrs.size() * HOST_BYTES;
+
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    if (ftruncate(file, total) < 0) {
+        perror("ftruncate");
+        close(file);
+        return nullptr;
+    }
+    std::unique_ptr<StateDb> db(new StateDb());
+    if (!db->map(file, total, true)) return nullptr;
+
+    StateDbHeader *hdr = reinterpret_cast<StateDbHeader*>(db->base);
+    std::memcpy(hdr->magic, DB_MAGIC, sizeof(DB_MAGIC));
+    hdr->version = DB_VERSION;
+    hdr->host_count = addrs.size();
+    hdr->data_offset = data_offset;
+    StateDbHost *index = reinterpret_cast<StateDbHost*>(db->base + sizeof(StateDbHeader));
+    for (size_t i = 0; i < addrs.size(); i++) {
+        bool v6 = addrs[i].find(':') != std::string::npos;
+        index[i].family = v6 ? 6 : 4;
+        inet_pton(v6 ? AF_INET6 : AF_INET, addrs[i].c_str(), index[i].addr);
+        db->by_address.emplace(addrs[i], i);
+    }
+    db->data = db->base + data_offset;
+    return db;
+}
+
+/**
+ * @brief Maps an existing database read-only and validates its layout.
+ *
+ * @param path Database file.
+ * @return std::unique_ptr<StateDb> nullptr on failure (error already printed).
+ */
+std::unique_ptr<StateDb> StateDb::open(const std::string &path) {
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(file, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(StateDbHeader)) {
+        std::cerr << path << ": not a port-state database" << std::endl;
+        close(file);
+        return nullptr;
+    }
+    std::unique_ptr<StateDb> db(new StateDb());
+    if (!db->map(file, st.st_size, false)) return nullptr;
+
+    const StateDbHeader *hdr = db->header;
+    if (std::memcmp(hdr->magic, DB_MAGIC, sizeof(DB_MAGIC)) != 0 || hdr->version != DB_VERSION ||
+        hdr->data_offset < sizeof(StateDbHeader) + static_cast<uint64_t>(hdr->host_count) * sizeof(StateDbHost) ||
+        hdr->data_offset + static_cast<uint64_t>(hdr->host_count) * HOST_BYTES > db->length) {
+        std::cerr << path << ": not a port-state database" << std::endl;
+        return nullptr;
+    }
+    db->data = db->base + hdr->data_offset;
+    return db;
+}
+
+/**
+ * @brief Stores a result reported in the common output format.
+ *
+ * Does not allocate. Concurrent callers are safe as long as they report different
+ * (host, protocol) pairs, which holds for the scan jobs.
+ *
+ * @param ip Target address, as printed by the scanners.
+ * @param port Scanned port.
+ * @param proto "tcp" or "udp".
+ * @param state "open", "closed" or "filtered".
+ * @return true If the host is part of the database.
+ */
+bool StateDb::record(const std::string &ip, int port, const char *proto, const char *state) {
+    auto it = by_address.find(ip);
+    if (it == by_address.end() || port < 0 || port >= static_cast<int>(PORTS)) return false;
+    State s = std::strcmp(state, "open") == 0 ? OPEN : std::strcmp(state, "closed") == 0 ? CLOSED : FILTERED;
+    uint8_t *array = data + static_cast<size_t>(it->second) * HOST_BYTES +
+                     (std::strcmp(proto, "udp") == 0 ? UDP : TCP) * ARRAY_BYTES;
+    uint8_t &byte = array[port >> 2];
+    int shift = (port & 3) * 2;
+    byte = static_cast<uint8_t>((byte & ~(3 << shift)) | (s << shift));
+    return true;
+}
+
+/**
+ * @brief Formats the address of index entry i.
+ */
+std::string StateDb::host_name(uint32_t i) const {
+    char buf[INET6_ADDRSTRLEN];
+    inet_ntop(hosts[i].family == 6 ? AF_INET6 : AF_INET, hosts[i].addr, buf, sizeof(buf));
+    return buf;
+}
+
+const char *StateDb::name(State s) {
+    switch (s) {
+        case OPEN:     return "open";
+        case CLOSED:   return "closed";
+        case FILTERED: return "filtered";
+        default:       return "unscanned";
+    }
+}
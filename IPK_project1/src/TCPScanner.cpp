@@ -1,4 +1,14 @@
 #include "TCPScanner.hpp"
+#include "ScanOutput.hpp"
+#include "PacketSource.hpp"
+#include "Timing.hpp"
+#include "SocketCache.hpp"
+#include "NextHop.hpp"
+#include "ProbePolicy.hpp"
+#include "PcapRecorder.hpp"
+#include "ScanLoop.hpp"
+#include <chrono>
+#include <cstdio>
 
 /**
  * @brief Constructs a TCPScanner instance.
@@ -8,354 +18,376 @@
  * @param src Source IP address to bind packets from.
  * @param p Vector of target TCP ports to scan.
  * @param timeout Timeout duration in milliseconds.
+ * @param uring Use the io_uring probe backend when the kernel supports it.
+ * @param rtt Print round-trip time and loss statistics to stderr when the scan ends.
+ * @param min_count Minimum number of SYNs per port.
+ * @param max_count Maximum number of SYNs per port.
  */
 TCPScanner::TCPScanner(const std::string& interface, const std::string& dst, const std::string& src,
-                       const std::vector<int>& p, int timeout)
-    : iface(interface), dst_ip(dst), src_ip(src), ports(p), timeout_ms(timeout) {}
+                       const std::vector<int>& p, int timeout, bool uring, bool rtt, int min_count, int max_count)
+    : iface(interface), dst_ip(dst), src_ip(src), ports(p), timeout_ms(timeout), use_uring(uring),
+      show_rtt(rtt), min_probes(min_count), max_probes(max_count) {}
 
 /**
- * @brief Computes checksum for an IPv4 header.
- * 
- * @param buf Pointer to header buffer.
- * @param len Length of the buffer.
- * @return unsigned short Checksum result.
+ * @brief Opens the raw IPv4 probe socket (IP_HDRINCL, also receives TCP replies).
+ *
+ * @return int Socket descriptor, -1 on failure.
  */
-unsigned short ip_checksum(unsigned short *buf, int len) {
-    unsigned long sum = 0;
-    while (len > 1) {
-        sum += *buf++;
-        len -= 2;
-    }
-    if (len == 1) {
-        unsigned short tmp = 0;
-        *(unsigned char*)(&tmp) = *(unsigned char*)buf;
-        sum += tmp;
-    }
-    while (sum >> 16) {
-        sum = (sum & 0xffff) + (sum >> 16);
-    }
-    return (unsigned short)(~sum);
+int open_raw_socket(const in_addr &) {
+    int sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    if (sock < 0) return -1;
+    int one = 1;
+    setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one));
+    return sock;
 }
 
 /**
- * @brief Computes TCP checksum using a pseudo header for IPv4.
- * 
- * @param iph Pointer to IPv4 header.
- * @param tcph Pointer to TCP header.
- * @param tcp_len Length of TCP segment.
- * @return unsigned short Calculated checksum.
+ * @brief Opens the raw IPv6 probe socket (IPV6_HDRINCL) bound to the source address.
+ *
+ * @return int Socket descriptor, -1 if the socket cannot be created, -2 if binding failed.
  */
-unsigned short tcp_checksum(const struct iphdr *iph, const struct tcphdr *tcph, int tcp_len) {
-    struct {
-        uint32_t src;
-        uint32_t dst;
-        uint8_t zero;
-        uint8_t proto;
-        uint16_t length;
-    } pseudo_header;
-    pseudo_header.src = iph->saddr;
-    pseudo_header.dst = iph->daddr;
-    pseudo_header.zero = 0;
-    pseudo_header.proto = IPPROTO_TCP;
-    pseudo_header.length = htons(tcp_len);
-
-    unsigned long sum = 0;
-    const unsigned short *p = (unsigned short*)&pseudo_header;
-    for (size_t i = 0; i < sizeof(pseudo_header)/2; ++i)
-        sum += *p++;
-    p = (unsigned short*)tcph;
-    for (int i = 0; i < tcp_len / 2; ++i)
-        sum += *p++;
-    if (tcp_len % 2 == 1)
-        sum += *((unsigned char*)tcph + tcp_len - 1) << 8;
-    while (sum >> 16)
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    return ~sum;
+int open_raw_socket(const in6_addr &src) {
+    int sock = socket(AF_INET6, SOCK_RAW, IPPROTO_RAW);
+    if (sock < 0) return -1;
+    int one = 1;
+    setsockopt(sock, IPPROTO_IPV6, IPV6_HDRINCL, &one, sizeof(one));
+    struct sockaddr_in6 src_addr;
+    memset(&src_addr, 0, sizeof(src_addr));
+    src_addr.sin6_family = AF_INET6;
+    src_addr.sin6_addr = src;
+    if (bind(sock, reinterpret_cast<struct sockaddr*>(&src_addr), sizeof(src_addr)) < 0) {
+        perror("bind");
+        close(sock);
+        return -2;
+    }
+    return sock;
 }
 
 /**
- * @brief Computes a general-purpose Internet checksum.
- * 
- * @param buf Pointer to data buffer.
- * @param len Length of data.
- * @return unsigned short Checksum.
+ * @brief Waits for the SYN-ACK or RST answering one probe.
+ *
+ * Every packet read that concerns the target is passed to the pcap recorder, if one is set.
+ *
+ * @param rx Packet source to read from.
+ * @param dst Target address.
+ * @param src_port Source port used in the SYN packet.
+ * @param dst_port Destination port being scanned.
+ * @param timeout_ms Timeout in milliseconds.
+ * @param stamp Set to the receive timestamp of the matching reply.
+ * @return TcpReply Open/Closed/Filtered on a matching reply, None if the timeout expired.
  */
-unsigned short calculate_checksum(unsigned short* buf, int len) {
-    unsigned long sum = 0;
-    while (len > 1) {
-        sum += *buf++;
-        len -= 2;
+template <class AF>
+static TcpReply await_reply(PacketSource &rx, const typename AF::addr_type &dst,
+                            uint16_t src_port, uint16_t dst_port, int timeout_ms, timespec &stamp) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return TcpReply::None;
+        const uint8_t *pkt;
+        ssize_t len = rx.next(pkt, static_cast<int>(left), &stamp);
+        if (len < 0) return TcpReply::None;
+        if (packet_recording() && concerns_target<AF>(pkt, len, dst)) record_packet(pkt, len, stamp);
+        TcpReply reply = classify_tcp_reply<AF>(pkt, len, dst, src_port, dst_port);
+        if (reply != TcpReply::None) return reply;
     }
-    if (len == 1)
-        sum += *(unsigned char*)buf;
-    while (sum >> 16)
-        sum = (sum & 0xffff) + (sum >> 16);
-    return static_cast<unsigned short>(~sum);
 }
 
 /**
- * @brief Sends a raw TCP SYN packet over IPv4.
- * 
- * @param sock Raw socket file descriptor.
- * @param src_ip Source IP address.
- * @param dst_ip Destination IP address.
- * @param src_port Source port.
- * @param dst_port Destination port.
+ * @brief Reports the state a port's final reply stands for; no reply means filtered.
  */
-void send_syn_packet(int sock, const std::string &src_ip, const std::string &dst_ip,
-                     uint16_t src_port, uint16_t dst_port) {
-    char packet[sizeof(struct iphdr) + sizeof(struct tcphdr)] = {0};
-    struct iphdr *iph = (struct iphdr *)packet;
-    struct tcphdr *tcph = (struct tcphdr *)(packet + sizeof(struct iphdr));
-    iph->ihl = 5;
-    iph->version = 4;
-    iph->tot_len = htons(sizeof(packet));
-    iph->ttl = 64;
-    iph->protocol = IPPROTO_TCP;
-    iph->saddr = inet_addr(src_ip.c_str());
-    iph->daddr = inet_addr(dst_ip.c_str());
-    iph->check = ip_checksum((unsigned short*)iph, sizeof(struct iphdr));
-    tcph->source = htons(src_port);
-    tcph->dest = htons(dst_port);
-    tcph->seq = htonl(rand());
-    tcph->doff = 5;
-    tcph->syn = 1;
-    tcph->window = htons(65535);
-    tcph->check = tcp_checksum(iph, tcph, sizeof(struct tcphdr));
-    sockaddr_in sin{};
-    sin.sin_family = AF_INET;
-    sin.sin_port = tcph->dest;
-    sin.sin_addr.s_addr = iph->daddr;
-    sendto(sock, packet, sizeof(packet), 0, (sockaddr*)&sin, sizeof(sin));
+static void report_reply(const std::string &ip, int port, TcpReply reply) {
+    switch (reply) {
+        case TcpReply::Open:   report_port(ip, port, "tcp", "open"); break;
+        case TcpReply::Closed: report_port(ip, port, "tcp", "closed"); break;
+        case TcpReply::Filtered:
+        case TcpReply::None:   report_port(ip, port, "tcp", "filtered"); break;
+    }
 }
 
-
 /**
- * @brief Listens for SYN-ACK or RST responses to determine port state over IPv4.
- * 
- * @param sock Raw socket descriptor.
- * @param src_port Port used as source in SYN packet.
- * @param dst_port Destination port being scanned.
- * @param dst_ip Target destination IP.
- * @param timeout_ms Timeout in milliseconds.
- * @return int 0 = open/closed (response), 1 = filtered (no response).
+ * @brief Wraps a raw-socket backend in a PACKET_TX_RING backend on the scan interface.
+ *
+ * The next-hop MAC address is resolved here, once per scan.
+ *
+ * @param dst Target address.
+ * @param io Raw-socket backend; moved into the ring backend on success.
+ * @return std::unique_ptr<ProbeIO> The ring backend, nullptr (with @p io untouched) on failure.
  */
-int listen_for_response(int sock, uint16_t src_port, uint16_t dst_port,
-                        const std::string &dst_ip, int timeout_ms) {
-    char buffer[BUFFER_SIZE];
-    sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
-    for (int i = 0; i < 30; ++i) {
-        int recv_len = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr*)&addr, &addr_len);
-        if (recv_len < 0) return 1;
-        struct ip *iph = (struct ip*)buffer;
-        if (iph->ip_p == IPPROTO_TCP) {
-            int ip_hdr_len = iph->ip_hl * 4;
-            struct tcphdr *tcph = (struct tcphdr*)(buffer + ip_hdr_len);
-            if (ntohs(tcph->dest) == src_port && ntohs(tcph->source) == dst_port) {
-                if (tcph->syn && tcph->ack) {
-                    std::cout << dst_ip << " " << dst_port << " tcp open" << std::endl;
-                    return 0;
-                } else if (tcph->rst) {
-                    std::cout << dst_ip << " " << dst_port << " tcp closed" << std::endl;
-                    return 0;
-                }
-            }
-        }
-    }
-    return 1;
+template <class AF>
+std::unique_ptr<ProbeIO> TCPScanner::link_layer_io(const typename AF::addr_type &dst,
+                                                   std::unique_ptr<ProbeIO> &io) {
+    LinkTarget link;
+    std::unique_ptr<ProbeIO> ring;
+    if (resolve_link_target(iface, AF::family, &dst, link))
+        ring = PacketRingIO::create(link, AF::ethertype, io);
+    if (!ring) std::cerr << "PACKET_TX_RING unavailable, using " << io->name() << std::endl;
+    return ring;
 }
 
 /**
- * @brief Sends a raw TCP SYN packet over IPv6.
- * 
- * @param sock Raw socket descriptor.
- * @param src_ip Source IPv6 address.
- * @param dst_ip Destination IPv6 address.
- * @param src_port Source TCP port.
- * @param dst_port Destination TCP port.
+ * @brief Runs the SYN scan for one address family.
+ *
+ * The packet template, sockets and capture are set up once; the per-port loop only patches
+ * the TCP header, sends it and classifies replies, without allocation or address parsing.
+ * Replies to first attempts feed the RTT estimator, whose timeout replaces `-w` once known.
+ * The number of SYNs per port follows the loss estimate of the retry budget (two to start with).
+ * With a deadline, the plan may lower the SYNs and the wait per port or stop before the last ports.
+ * An ICMP unreachable quoting a probe ends the wait at once with the port filtered.
+ * With the TX ring, probes leave as Ethernet frames while replies still come from the socket
+ * or capture.
+ *
+ * @param src Source address.
+ * @param dst Destination address.
+ * @return true If the scan ran, false if the raw socket could not be opened.
  */
-void send_syn_packet_ipv6(int sock, const std::string& src_ip, const std::string& dst_ip,
-                          uint16_t src_port, uint16_t dst_port) {
-    char packet[sizeof(struct ip6_hdr) + sizeof(struct tcphdr)];
-    memset(packet, 0, sizeof(packet));
-    struct ip6_hdr* ip6h = reinterpret_cast<struct ip6_hdr*>(packet);
-    ip6h->ip6_flow = htonl(0x60000000);
-    ip6h->ip6_plen = htons(sizeof(struct tcphdr));
-    ip6h->ip6_nxt  = IPPROTO_TCP;
-    ip6h->ip6_hops = 64;
-    if (inet_pton(AF_INET6, src_ip.c_str(), &ip6h->ip6_src) != 1) {
-        std::cerr << "Invalid source IPv6 address\n";
-        return;
+template <class AF>
+bool TCPScanner::scan_family(const typename AF::addr_type &src, const typename AF::addr_type &dst) {
+    int sock = cache ? cache->tcp_socket(src) : open_raw_socket(src);
+    if (sock == -1) {
+        std::cerr << "TCP socket error: " << strerror(errno) << std::endl;
+        return false;
     }
-    if (inet_pton(AF_INET6, dst_ip.c_str(), &ip6h->ip6_dst) != 1) {
-        std::cerr << "Invalid destination IPv6 address\n";
-        return;
+    if (sock < 0) return true;
+
+    sockaddr_storage dst_addr;
+    socklen_t dst_len = AF::to_sockaddr(dst, dst_addr);
+    std::unique_ptr<ProbeIO> io = make_probe_io(sock, reinterpret_cast<sockaddr*>(&dst_addr), dst_len,
+                                                AF::socket_receives, use_uring && !cache);
+    if (tx_ring) {
+        std::unique_ptr<ProbeIO> ring = link_layer_io<AF>(dst, io);
+        if (ring) io = std::move(ring);
+    }
+    std::unique_ptr<PacketSource> owned_rx, icmp_rx, merged_rx;
+    int icmp_sock = -1;
+    PacketSource *rx;
+    if constexpr (AF::socket_receives) {
+        // The raw TCP socket does not see ICMP errors; read them from a second socket.
+        owned_rx.reset(new SocketSource(*io));
+        rx = owned_rx.get();
+        icmp_sock = cache ? cache->icmp_socket(AF::family) : socket(AF::family, SOCK_RAW, AF::icmp_protocol);
+        if (icmp_sock >= 0) {
+            icmp_rx.reset(new RawSocketSource(icmp_sock));
+            merged_rx.reset(new MergedSource(*owned_rx, *icmp_rx));
+            rx = merged_rx.get();
+        }
+    } else {
+        if (cache) {
+            rx = cache->tcp6_capture(iface);
+        } else {
+            owned_rx = PcapSource::open_live(iface, "ip6 and ((tcp and src host " + dst_ip + ") or icmp6)");
+            rx = owned_rx.get();
+        }
+        if (!rx) {
+            io.reset();
+            if (!cache) close(sock);
+            return true;
+        }
     }
-    struct tcphdr* tcph = reinterpret_cast<struct tcphdr*>(packet + sizeof(struct ip6_hdr));
-    tcph->source = htons(src_port);
-    tcph->dest   = htons(dst_port);
-    tcph->seq    = htonl(rand());
-    tcph->doff   = 5;
-    tcph->syn    = 1;
-    tcph->window = htons(65535);
-    tcph->check  = 0;
-    struct {
-        struct in6_addr src;
-        struct in6_addr dst;
-        uint32_t tcp_len;
-        uint8_t zeros[3];
-        uint8_t next_hdr;
-    } pseudo_hdr;
-    pseudo_hdr.src = ip6h->ip6_src;
-    pseudo_hdr.dst = ip6h->ip6_dst;
-    pseudo_hdr.tcp_len = htonl(sizeof(struct tcphdr));
-    memset(pseudo_hdr.zeros, 0, sizeof(pseudo_hdr.zeros));
-    pseudo_hdr.next_hdr = IPPROTO_TCP;
-    char pseudo_packet[sizeof(pseudo_hdr) + sizeof(struct tcphdr)];
-    memcpy(pseudo_packet, &pseudo_hdr, sizeof(pseudo_hdr));
-    memcpy(pseudo_packet + sizeof(pseudo_hdr), tcph, sizeof(struct tcphdr));
-    tcph->check = calculate_checksum(reinterpret_cast<unsigned short*>(pseudo_packet),
-                                     sizeof(pseudo_packet));
-    if (tcph->check == 0) tcph->check = 0xFFFF;
-    struct sockaddr_in6 dst_addr;
-    memset(&dst_addr, 0, sizeof(dst_addr));
-    dst_addr.sin6_family = AF_INET6;
-    dst_addr.sin6_port = 0;
-    if (inet_pton(AF_INET6, dst_ip.c_str(), &dst_addr.sin6_addr) != 1) {
-        std::cerr << "Invalid destination IPv6 address\n";
-        return;
+
+    TcpProbe<AF> probe(src, dst);
+    ProbePolicy policy(timeout_ms, true, 2, min_probes, max_probes, deadline, ports.size());
+    srand(time(nullptr));
+    for (int port : ports) {
+        uint16_t src_port = 20000 + (rand() % 20000);
+        TcpReply reply = TcpReply::None;
+        int limit;
+        if (!policy.next_port(limit)) break;
+        int attempt = 0;
+        for (; attempt < limit && reply == TcpReply::None; ++attempt) {
+            timespec sent = wall_clock_now(), received;
+            const uint8_t *syn = probe.build(src_port, port, rand(), TH_SYN);
+            io->send(syn, probe.size());
+            io->flush();
+            record_packet(syn, probe.size(), sent);
+            reply = await_reply<AF>(*rx, dst, src_port, port, policy.wait_ms(), received);
+            if ((reply == TcpReply::Open || reply == TcpReply::Closed) && attempt == 0)
+                policy.sample(sent, received);
+        }
+        policy.finish_port(attempt, reply != TcpReply::None);
+        report_reply(dst_ip, port, reply);
     }
-    if (sendto(sock, packet, sizeof(packet), 0, reinterpret_cast<struct sockaddr*>(&dst_addr), sizeof(dst_addr)) < 0) {
-        perror("sendto");
+    policy.print(dst_ip, "tcp", show_rtt);
+    merged_rx.reset();
+    icmp_rx.reset();
+    owned_rx.reset();
+    io.reset();
+    if (!cache) {
+        if (icmp_sock >= 0) close(icmp_sock);
+        close(sock);
     }
+    return true;
 }
 
 /**
- * @brief Uses libpcap to capture IPv6 TCP responses to SYN packets.
- * 
- * @param iface Interface to listen on (e.g., \"wlp3s0\").
- * @param src_port Source port used in the SYN packet.
- * @param dst_port Destination port being scanned.
- * @param dst_ip Target IPv6 address.
- * @param timeout_ms Timeout in milliseconds for capture.
- * @return int 0 = open/closed, 1 = filtered.
+ * @brief The SYN scan of scan_family() as a coroutine on an event loop.
+ *
+ * Sends and reply waits go through the loop: the task suspends while the socket buffer is
+ * full and while it waits for the reply, so other targets progress in the meantime. Retry
+ * budget, RTT estimate and deadline plan work as on a thread.
+ *
+ * @param loop Loop owning the sockets; the reply source of the family must be open.
+ * @param src Source address.
+ * @param dst Destination address.
  */
-int listen_for_response_ipv6_pcap(const std::string &iface,
-                                  unsigned short src_port, unsigned short dst_port,
-                                  const std::string &dst_ip, int timeout_ms) {
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t *handle = pcap_open_live(iface.c_str(), 65535, 1, timeout_ms, errbuf);
-    if (!handle) {
-        std::cerr << "pcap_open_live: " << errbuf << std::endl;
-        return 1;
+template <class AF>
+ScanTask TCPScanner::scan_coroutine(ScanLoop &loop, typename AF::addr_type src, typename AF::addr_type dst) {
+    sockaddr_storage dst_addr;
+    socklen_t dst_len = AF::to_sockaddr(dst, dst_addr);
+    TcpProbe<AF> probe(src, dst);
+    ProbePolicy policy(timeout_ms, true, 2, min_probes, max_probes, deadline, ports.size());
+    for (int port : ports) {
+        uint16_t src_port = 20000 + (rand() % 20000);
+        TcpReply reply = TcpReply::None;
+        int limit;
+        if (!policy.next_port(limit)) break;
+        int attempt = 0;
+        for (; attempt < limit && reply == TcpReply::None; ++attempt) {
+            const uint8_t *syn = probe.build(src_port, port, rand(), TH_SYN);
+            timespec sent = wall_clock_now();
+            while (!co_await loop.send_tcp(AF::family, syn, probe.size(), dst_addr, dst_len))
+                sent = wall_clock_now();
+            record_packet(syn, probe.size(), sent);
+            TcpReplyWait<AF> answer(loop, dst, src_port, port, policy.wait_ms());
+            reply = co_await answer;
+            if ((reply == TcpReply::Open || reply == TcpReply::Closed) && attempt == 0)
+                policy.sample(sent, answer.stamp);
+        }
+        policy.finish_port(attempt, reply != TcpReply::None);
+        report_reply(dst_ip, port, reply);
     }
-    char filter_exp[256];
-    snprintf(filter_exp, sizeof(filter_exp),
-             "ip6 and tcp and src host %s and src port %d and dst port %d",
-             dst_ip.c_str(), dst_port, src_port);
-    struct bpf_program fp;
-    if (pcap_compile(handle, &fp, filter_exp, 0, PCAP_NETMASK_UNKNOWN) == -1) {
-        std::cerr << "pcap_compile error: " << pcap_geterr(handle) << std::endl;
-        pcap_close(handle);
-        return 1;
+    policy.print(dst_ip, "tcp", show_rtt);
+}
+
+/**
+ * @brief Sends SYNs to the scanned ports in turn as fast as the backend allows.
+ *
+ * @return double Seconds until the last packet was handed to the kernel.
+ */
+template <class AF>
+static double measure_tx(ProbeIO &io, TcpProbe<AF> &probe, const std::vector<int> &ports, unsigned count) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < count; i++) {
+        int port = ports[i % ports.size()];
+        io.send(probe.build(static_cast<uint16_t>(20000 + (i % 20000)), static_cast<uint16_t>(port), rand(), TH_SYN),
+                probe.size());
     }
-    if (pcap_setfilter(handle, &fp) == -1) {
-        std::cerr << "pcap_setfilter error: " << pcap_geterr(handle) << std::endl;
-        pcap_freecode(&fp);
-        pcap_close(handle);
-        return 1;
+    io.flush();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Compares the transmit rate of the raw socket and the PACKET_TX_RING for one family.
+ */
+template <class AF>
+bool TCPScanner::benchmark_family(const typename AF::addr_type &src, const typename AF::addr_type &dst,
+                                  unsigned count) {
+    int sock = open_raw_socket(src);
+    if (sock == -1) {
+        std::cerr << "TCP socket error: " << strerror(errno) << std::endl;
+        return false;
     }
-    pcap_freecode(&fp);
-    
-    struct pcap_pkthdr *header;
-    const u_char *packet;
-    int ret;
-    while ((ret = pcap_next_ex(handle, &header, &packet)) >= 0) {
-        if (ret == 0) continue;
-        int offset = 0;
-        int dlt = pcap_datalink(handle);
-        if (dlt == DLT_EN10MB) {
-            offset = 14;
-        }
-        if (header->caplen < offset + sizeof(struct ip6_hdr) + sizeof(struct tcphdr))
-            continue;
-        struct ip6_hdr *ip6h_cap = (struct ip6_hdr*)(packet + offset);
-        if (ip6h_cap->ip6_nxt != IPPROTO_TCP)
-            continue;
-        struct tcphdr *tcph_cap = (struct tcphdr*)(packet + offset + sizeof(struct ip6_hdr));
-        if (ntohs(tcph_cap->dest) != src_port || ntohs(tcph_cap->source) != dst_port)
-            continue;
-        if (tcph_cap->syn && tcph_cap->ack) {
-            std::cout << dst_ip << " " << dst_port << " tcp open" << std::endl;
-            pcap_close(handle);
-            return 0;
-        } else if (tcph_cap->rst) {
-            std::cout << dst_ip << " " << dst_port << " tcp closed" << std::endl;
-            pcap_close(handle);
-            return 0;
-        }
+    if (sock < 0) return true;
+    sockaddr_storage dst_addr;
+    socklen_t dst_len = AF::to_sockaddr(dst, dst_addr);
+    std::unique_ptr<ProbeIO> io = make_probe_io(sock, reinterpret_cast<sockaddr*>(&dst_addr), dst_len,
+                                                false, use_uring);
+    TcpProbe<AF> probe(src, dst);
+    srand(time(nullptr));
+
+    auto report = [&](const char *name, double seconds) {
+        double pps = seconds > 0 ? count / seconds : 0;
+        fprintf(stderr, "%s tx %-16s %u packets in %.1f ms, %.0f pps\n",
+                dst_ip.c_str(), name, count, seconds * 1000, pps);
+        return pps;
+    };
+    double socket_pps = report(io->name(), measure_tx<AF>(*io, probe, ports, count));
+    std::unique_ptr<ProbeIO> ring = link_layer_io<AF>(dst, io);
+    if (ring) {
+        double ring_pps = report(ring->name(), measure_tx<AF>(*ring, probe, ports, count));
+        if (socket_pps > 0)
+            fprintf(stderr, "%s tx packet_tx_ring is %.2fx the socket rate\n", dst_ip.c_str(), ring_pps / socket_pps);
     }
-    pcap_close(handle);
-    return 1;
+    ring.reset();
+    io.reset();
+    close(sock);
+    return true;
+}
+
+/**
+ * @brief Runs the transmit benchmark against the target instead of scanning it.
+ *
+ * @param count Number of SYNs per backend.
+ * @return true If the benchmark ran, false if the raw socket could not be opened.
+ */
+bool TCPScanner::benchmark(unsigned count) {
+    in_addr src4, dst4;
+    in6_addr src6, dst6;
+    if (ports.empty()) return true;
+    if (IPv4Family::parse(dst_ip, dst4) && IPv4Family::parse(src_ip, src4))
+        return benchmark_family<IPv4Family>(src4, dst4, count);
+    if (IPv6Family::parse(dst_ip, dst6) && IPv6Family::parse(src_ip, src6))
+        return benchmark_family<IPv6Family>(src6, dst6, count);
+    std::cerr << "Invalid address " << dst_ip << "\n";
+    return true;
 }
 
 /**
  * @brief Scans all specified TCP ports by sending SYN packets and interpreting responses.
  * 
  * Handles both IPv4 and IPv6 targets using raw sockets and pcap (for IPv6 response detection).
+ *
+ * @return true If the scan ran, false if the raw socket could not be opened (e.g. missing privileges).
  */
-void TCPScanner::scan() {
-    bool is_ipv6 = dst_ip.find(':') != std::string::npos;
-    int sock = socket(is_ipv6 ? AF_INET6 : AF_INET, SOCK_RAW, is_ipv6 ? IPPROTO_RAW : IPPROTO_TCP);
-    if (sock < 0) {
-        std::cerr << "TCP socket error: " << strerror(errno) << std::endl;
-        return;
+bool TCPScanner::scan() {
+    in_addr src4, dst4;
+    in6_addr src6, dst6;
+    if (IPv4Family::parse(dst_ip, dst4)) {
+        if (!IPv4Family::parse(src_ip, src4)) {
+            std::cerr << "Invalid IPv4 source address\n";
+            return true;
+        }
+        return scan_family<IPv4Family>(src4, dst4);
     }
-    int one = 1;
-    if (is_ipv6) {
-        setsockopt(sock, IPPROTO_IPV6, IPV6_HDRINCL, &one, sizeof(one));
-        struct sockaddr_in6 src_addr;
-        memset(&src_addr, 0, sizeof(src_addr));
-        src_addr.sin6_family = AF_INET6;
-        src_addr.sin6_port = 0;
-        if (inet_pton(AF_INET6, src_ip.c_str(), &src_addr.sin6_addr) != 1) {
+    if (IPv6Family::parse(dst_ip, dst6)) {
+        if (!IPv6Family::parse(src_ip, src6)) {
             std::cerr << "Invalid IPv6 source address\n";
-            close(sock);
-            return;
+            return true;
         }
-        if (bind(sock, reinterpret_cast<struct sockaddr*>(&src_addr), sizeof(src_addr)) < 0) {
-            perror("bind");
-            close(sock);
-            return;
+        return scan_family<IPv6Family>(src6, dst6);
+    }
+    std::cerr << "Invalid destination address " << dst_ip << "\n";
+    return true;
+}
+
+/**
+ * @brief Queues the scan as a coroutine on an event loop.
+ *
+ * @param loop Loop that runs the task and owns the sockets.
+ * @return true If the task was queued or the addresses are invalid (error printed),
+ *         false if the loop cannot send raw TCP probes for the target's family.
+ */
+bool TCPScanner::schedule(ScanLoop &loop) {
+    in_addr src4, dst4;
+    in6_addr src6, dst6;
+    if (IPv4Family::parse(dst_ip, dst4)) {
+        if (!IPv4Family::parse(src_ip, src4)) {
+            std::cerr << "Invalid IPv4 source address\n";
+            return true;
         }
-    } else {
-        setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one));
+        if (!loop.open_tcp(AF_INET)) return false;
+        loop.spawn(scan_coroutine<IPv4Family>(loop, src4, dst4));
+        return true;
     }
-    srand(time(nullptr));
-    for (int port : ports) {
-        unsigned short src_port = 20000 + (rand() % 20000);
-        if (is_ipv6) {
-            send_syn_packet_ipv6(sock, src_ip, dst_ip, src_port, port);
-            if (listen_for_response_ipv6_pcap(iface, src_port, port, dst_ip, timeout_ms)) {
-                send_syn_packet_ipv6(sock, src_ip, dst_ip, src_port, port);
-                if (listen_for_response_ipv6_pcap(iface, src_port, port, dst_ip, timeout_ms)) {
-                    std::cout << dst_ip << " " << port << " tcp filtered" << std::endl;
-                }
-            }
-        } else {
-            send_syn_packet(sock, src_ip, dst_ip, src_port, port);
-            if (listen_for_response(sock, src_port, port, dst_ip, timeout_ms)) {
-                send_syn_packet(sock, src_ip, dst_ip, src_port, port);
-                if (listen_for_response(sock, src_port, port, dst_ip, timeout_ms)) {
-                    std::cout << dst_ip << " " << port << " tcp filtered" << std::endl;
-                }
-            }
+    if (IPv6Family::parse(dst_ip, dst6)) {
+        if (!IPv6Family::parse(src_ip, src6)) {
+            std::cerr << "Invalid IPv6 source address\n";
+            return true;
         }
+        if (!loop.open_tcp(AF_INET6)) return false;
+        loop.spawn(scan_coroutine<IPv6Family>(loop, src6, dst6));
+        return true;
     }
-    close(sock);
-}
\ No newline at end of file
+    std::cerr << "Invalid destination address " << dst_ip << "\n";
+    return true;
+}
@@ -0,0 +1,116 @@
+#include "Timing.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sys/socket.h>
+
+timespec wall_clock_now() {
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now;
+}
+
+/**
+ * @brief Asks the kernel to timestamp every packet received on the socket (SO_TIMESTAMPNS).
+ *
+ * Failure is not fatal: recv_stamped() then falls back to the time of the call.
+ */
+void enable_rx_timestamps(int sock) {
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+}
+
+/**
+ * @brief Receives one packet together with its kernel receive timestamp.
+ *
+ * @param sock Socket to read from; honours its SO_RCVTIMEO.
+ * @param buf Destination buffer.
+ * @param len Buffer size.
+ * @param stamp Set to the SO_TIMESTAMPNS time, or to the current time if the kernel gave none.
+ * @param flags recvmsg() flags, e.g. MSG_DONTWAIT.
+ * @param from If not null, set to the sender address.
+ * @return ssize_t Number of bytes received, -1 on error (as recv()).
+ */
+ssize_t recv_stamped(int sock, void *buf, size_t len, timespec *stamp, int flags, sockaddr_storage *from) {
+    struct iovec iov{buf, len};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(timespec))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_name = from;
+    msg.msg_namelen = from ? sizeof(*from) : 0;
+    msg.msg_control = stamp ? control : nullptr;
+    msg.msg_controllen = stamp ? sizeof(control) : 0;
+    ssize_t n = recvmsg(sock, &msg, flags);
+    if (n < 0 || !stamp) return n;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(stamp, CMSG_DATA(c), sizeof(timespec));
+            return n;
+        }
+    }
+    *stamp = wall_clock_now();
+    return n;
+}
+
+/**
+ * @brief Adds the RTT of an unambiguous probe/reply pair.
+ *
+ * Replies to retransmitted probes must not be sampled (Karn's algorithm): it is unknown
+ * which copy they answer.
+ *
+ * @param sent Time the probe was handed to the kernel.
+ * @param received Receive timestamp of the reply.
+ */
+void RttEstimator::sample(const timespec &sent, const timespec &received) {
+    double rtt = elapsed_ns(sent, received) / 1e6;
+    if (rtt < 0) return;
+    if (!have_sample) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+        min_rtt = max_rtt = rtt;
+        have_sample = true;
+    } else {
+        rttvar = 0.75 * rttvar + 0.25 * std::fabs(srtt - rtt);
+        srtt = 0.875 * srtt + 0.125 * rtt;
+        min_rtt = std::min(min_rtt, rtt);
+        max_rtt = std::max(max_rtt, rtt);
+    }
+    sum_rtt += rtt;
+    samples++;
+}
+
+/**
+ * @brief Current wait for a reply, in milliseconds.
+ */
+int RttEstimator::timeout_ms() const {
+    if (!have_sample) return max_ms;
+    int rto = static_cast<int>(std::ceil(srtt + 4 * rttvar));
+    return std::min(max_ms, std::max(rto, MIN_TIMEOUT_MS));
+}
+
+/**
+ * @brief Shortest useful wait: the largest RTT measured so far, at least MIN_TIMEOUT_MS.
+ *
+ * Unlike the RTO it carries no variance margin, so a tight deadline can cut the wait below
+ * timeout_ms() while still covering every reply seen. Never above timeout_ms().
+ */
+int RttEstimator::floor_ms() const {
+    int measured = have_sample ? static_cast<int>(std::ceil(max_rtt)) : 0;
+    return std::min(timeout_ms(), std::max(measured, MIN_TIMEOUT_MS));
+}
+
+/**
+ * @brief Prints min/avg/max RTT and the final wait to stderr.
+ */
+void RttEstimator::print(const std::string &ip, const char *proto) const {
+    if (!samples) {
+        std::cerr << ip << " " << proto << " rtt: no samples" << std::endl;
+        return;
+    }
+    std::cerr << ip << " " << proto << " rtt min/avg/max " << min_rtt << "/" << sum_rtt / samples
+              << "/" << max_rtt << " ms, " << samples << " samples, wait " << timeout_ms() << " ms"
+              << std::endl;
+}
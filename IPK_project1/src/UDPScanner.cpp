@@ -1,11 +1,18 @@
 #include "UDPScanner.hpp"
+#include "ScanOutput.hpp"
+#include "AddressFamily.hpp"
+#include "Timing.hpp"
+#include "SocketCache.hpp"
+#include "ProbePolicy.hpp"
+#include "PcapRecorder.hpp"
+#include "ScanLoop.hpp"
 #include <iostream>
+#include <chrono>
 #include <cstring>
+#include <algorithm>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include <netinet/ip_icmp.h>
-#include <netinet/icmp6.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 
@@ -17,112 +24,275 @@ const int BUFFER_SIZE = 1500;
  * @param dst Destination IP address (IPv4 or IPv6).
  * @param p Ports to scan.
  * @param timeout Timeout in milliseconds to wait for ICMP replies.
+ * @param rtt Print round-trip time and loss statistics to stderr when the scan ends.
+ * @param min_count Minimum number of datagrams per port.
+ * @param max_count Maximum number of datagrams per port.
  */
-UDPScanner::UDPScanner(const std::string& dst, const std::vector<int>& p, int timeout)
-    : dst_ip(dst), ports(p), timeout_ms(timeout) {}
+UDPScanner::UDPScanner(const std::string& dst, const std::vector<int>& p, int timeout, bool rtt,
+                       int min_count, int max_count)
+    : dst_ip(dst), ports(p), timeout_ms(timeout), show_rtt(rtt), min_probes(min_count), max_probes(max_count) {}
 
 /**
- * @brief Receives an ICMPv4 Port Unreachable response.
- * 
- * @param recv_sock Raw socket for receiving ICMP.
- * @param timeout_ms Timeout in milliseconds.
- * @return true If port is closed (ICMP type 3 code 3 received).
- * @return false If no such ICMP message received in time.
+ * @brief Passes a sent datagram to the pcap recorder, rebuilt with its IP/IPv6 and UDP headers.
+ *
+ * The kernel builds the real headers; the copy carries the same addresses, ports and checksum.
  */
-static bool receive_icmp(int recv_sock, int timeout_ms) {
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(recv_sock, &fds);
-    struct timeval tv{timeout_ms/1000, (timeout_ms%1000)*1000};
-    if (select(recv_sock+1, &fds, nullptr, nullptr, &tv) <= 0) return false;
-
-    char buf[BUFFER_SIZE];
-    sockaddr_in src{};
-    socklen_t len = sizeof(src);
-    ssize_t n = recvfrom(recv_sock, buf, sizeof(buf), 0, (sockaddr*)&src, &len);
-    if (n < (int)(sizeof(struct iphdr) + sizeof(struct icmphdr))) return false;
-
-    struct iphdr *ip = (struct iphdr*)buf;
-    struct icmphdr *icmp = (struct icmphdr*)(buf + (ip->ihl*4));
-    return (icmp->type == ICMP_DEST_UNREACH && icmp->code == ICMP_PORT_UNREACH);
+template <class AF>
+static void record_datagram(const typename AF::addr_type &src, uint16_t src_port,
+                            const typename AF::addr_type &dst, uint16_t dst_port, const timespec &stamp) {
+    constexpr size_t l3_len = sizeof(typename AF::header_type);
+    uint8_t pkt[l3_len + sizeof(struct udphdr)];
+    AF::write_header(pkt, src, dst, IPPROTO_UDP, sizeof(struct udphdr));
+    struct udphdr *udph = reinterpret_cast<struct udphdr*>(pkt + l3_len);
+    udph->source = htons(src_port);
+    udph->dest = htons(dst_port);
+    udph->len = htons(sizeof(struct udphdr));
+    udph->check = 0;
+    udph->check = csum_fold(csum_add(AF::pseudo_sum(src, dst, IPPROTO_UDP, sizeof(struct udphdr)),
+                                     udph, sizeof(*udph)));
+    record_packet(pkt, sizeof(pkt), stamp);
 }
 
 /**
- * @brief Receives an ICMPv6 Port Unreachable response.
- * 
- * @param recv_sock Raw socket for receiving ICMPv6.
- * @param timeout_ms Timeout in milliseconds.
- * @return true If port is closed (ICMPv6 type 1 code 4 received).
- * @return false If no such ICMPv6 message received in time.
+ * @brief Passes an ICMP/ICMPv6 message read from the raw socket to the pcap recorder if it
+ * concerns `dst`.
+ *
+ * An ICMPv6 socket delivers the message without the IPv6 header, so one is put back in front
+ * from the sender and local addresses.
  */
-static bool receive_icmp6(int recv_sock, int timeout_ms) {
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(recv_sock, &fds);
-    struct timeval tv{timeout_ms/1000, (timeout_ms%1000)*1000};
-    if (select(recv_sock+1, &fds, nullptr, nullptr, &tv) <= 0) return false;
-
-    char buf[BUFFER_SIZE];
-    sockaddr_in6 src{};
-    socklen_t len = sizeof(src);
-    ssize_t n = recvfrom(recv_sock, buf, sizeof(buf), 0, (sockaddr*)&src, &len);
-    if (n < (int)(sizeof(struct icmp6_hdr))) return false;
-
-    struct icmp6_hdr *icmp6 = (struct icmp6_hdr*)buf;
-    return (icmp6->icmp6_type == 1 && icmp6->icmp6_code == 4);
+template <class AF>
+static void record_icmp(const uint8_t *buf, size_t len, const sockaddr_storage &from,
+                        const typename AF::addr_type &local, const typename AF::addr_type &dst,
+                        const timespec &stamp) {
+    if constexpr (AF::family == AF_INET) {
+        if (concerns_target<AF>(buf, len, dst)) record_packet(buf, len, stamp);
+    } else {
+        constexpr size_t l3_len = sizeof(typename AF::header_type);
+        uint8_t pkt[l3_len + BUFFER_SIZE];
+        len = std::min(len, static_cast<size_t>(BUFFER_SIZE));
+        AF::write_header(pkt, reinterpret_cast<const sockaddr_in6*>(&from)->sin6_addr, local,
+                         AF::icmp_protocol, len);
+        memcpy(pkt + l3_len, buf, len);
+        if (concerns_target<AF>(pkt, l3_len + len, dst)) record_packet(pkt, l3_len + len, stamp);
+    }
 }
 
 /**
- * @brief Performs UDP port scan on the target IP address.
- * 
- * Uses raw sockets to send empty datagrams and checks for ICMP unreachable replies.
+ * @brief Looks up the local address the kernel uses to reach `dst`, for recorded datagrams.
  */
-void UDPScanner::scan() {
-    bool is_ipv6 = dst_ip.find(':') != std::string::npos;
-
-    if (is_ipv6) {
-        int send_sock = socket(AF_INET6, SOCK_DGRAM, 0);
-        int recv_sock = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
-        if (send_sock < 0 || recv_sock < 0) {
-            perror("socket");
-            return;
-        }
+template <class AF>
+static typename AF::addr_type local_address(const sockaddr_storage &dst, socklen_t dst_len) {
+    typename AF::addr_type local{};
+    int sock = socket(AF::family, SOCK_DGRAM, 0);
+    if (sock < 0) return local;
+    sockaddr_storage name;
+    socklen_t name_len = sizeof(name);
+    if (connect(sock, reinterpret_cast<const sockaddr*>(&dst), dst_len) == 0 &&
+        getsockname(sock, reinterpret_cast<sockaddr*>(&name), &name_len) == 0) {
+        if constexpr (AF::family == AF_INET)
+            local = reinterpret_cast<sockaddr_in*>(&name)->sin_addr;
+        else
+            local = reinterpret_cast<sockaddr_in6*>(&name)->sin6_addr;
+    }
+    close(sock);
+    return local;
+}
 
-        for (auto port : ports) {
-            sockaddr_in6 dst{};
-            dst.sin6_family = AF_INET6;
-            dst.sin6_port = htons(port);
-            inet_pton(AF_INET6, dst_ip.c_str(), &dst.sin6_addr);
+/**
+ * @brief Returns the local port of the UDP send socket, binding it to an ephemeral port first
+ *        if it has none yet, so it is known before the first sendto() and never changes.
+ */
+static uint16_t source_port(int sock, int family) {
+    sockaddr_storage name{};
+    socklen_t name_len = sizeof(name);
+    if (getsockname(sock, reinterpret_cast<sockaddr*>(&name), &name_len) < 0) return 0;
+    // sin_port and sin6_port share their offset.
+    if (reinterpret_cast<sockaddr_in*>(&name)->sin_port == 0) {
+        memset(&name, 0, sizeof(name));
+        name.ss_family = static_cast<sa_family_t>(family);
+        name_len = family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+        if (bind(sock, reinterpret_cast<sockaddr*>(&name), name_len) < 0 ||
+            getsockname(sock, reinterpret_cast<sockaddr*>(&name), &name_len) < 0) return 0;
+    }
+    return ntohs(reinterpret_cast<sockaddr_in*>(&name)->sin_port);
+}
+
+/**
+ * @brief Waits for an ICMP/ICMPv6 Port Unreachable answering the datagram sent to one port.
+ *
+ * Only errors quoting a UDP datagram to `dst`:`port` count, so several scans can share the
+ * host without picking up each other's replies.
+ *
+ * @param recv_sock Raw socket for receiving ICMP/ICMPv6.
+ * @param dst Target address.
+ * @param port Probed UDP port.
+ * @param timeout_ms Timeout in milliseconds.
+ * @param stamp Set to the kernel receive timestamp of the matching error.
+ * @param local Local address of the scan, used when recording received messages.
+ * @return true If port is closed (port unreachable received).
+ * @return false If no such message arrived in time.
+ */
+template <class AF>
+static bool receive_port_unreachable(int recv_sock, const typename AF::addr_type &dst, int port, int timeout_ms,
+                                     timespec &stamp, const typename AF::addr_type &local) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint8_t buf[BUFFER_SIZE];
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(recv_sock, &fds);
+        struct timeval tv{static_cast<time_t>(left / 1000000), static_cast<suseconds_t>(left % 1000000)};
+        if (select(recv_sock+1, &fds, nullptr, nullptr, &tv) <= 0) return false;
+
+        sockaddr_storage from;
+        ssize_t n = recv_stamped(recv_sock, buf, sizeof(buf), &stamp, 0, &from);
+        if (n <= 0) continue;
+        if (packet_recording()) record_icmp<AF>(buf, n, from, local, dst, stamp);
+        size_t icmp_len;
+        const uint8_t *icmp = AF::raw_icmp_message(buf, n, icmp_len);
+        IcmpError err;
+        if (!icmp || !AF::parse_icmp_error(icmp, icmp_len, IPPROTO_UDP, dst, err)) continue;
+        const struct udphdr *udph = reinterpret_cast<const struct udphdr*>(err.quote);
+        if (ntohs(udph->dest) != port) continue;
+        if (err.type == AF::unreach_type && err.code == AF::port_unreach_code) return true;
+    }
+}
+
+/**
+ * @brief Runs the UDP scan for one address family.
+ *
+ * @param dst Target address.
+ */
+template <class AF>
+void UDPScanner::scan_family(const typename AF::addr_type &dst) {
+    int send_sock = cache ? cache->udp_socket(AF::family) : socket(AF::family, SOCK_DGRAM, 0);
+    int recv_sock = cache ? cache->icmp_socket(AF::family) : socket(AF::family, SOCK_RAW, AF::icmp_protocol);
+    if (send_sock < 0 || recv_sock < 0) {
+        perror("socket");
+        if (!cache && send_sock >= 0) close(send_sock);
+        if (!cache && recv_sock >= 0) close(recv_sock);
+        return;
+    }
 
-            sendto(send_sock, nullptr, 0, 0, (sockaddr*)&dst, sizeof(dst));
+    enable_rx_timestamps(recv_sock);
+    // The wait stays at -w: RTT is measured for reporting only, and as the lower bound when a
+    // deadline forces shorter waits.
+    ProbePolicy policy(timeout_ms, false, 1, min_probes, max_probes, deadline, ports.size());
+    sockaddr_storage addr;
+    socklen_t addr_len = AF::to_sockaddr(dst, addr);
+    typename AF::addr_type local{};
+    uint16_t local_port = 0;
+    if (packet_recording()) {
+        local = local_address<AF>(addr, addr_len);
+        local_port = source_port(send_sock, AF::family);
+    }
+    for (auto port : ports) {
+        if (AF::family == AF_INET)
+            reinterpret_cast<sockaddr_in*>(&addr)->sin_port = htons(port);
+        else
+            reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port = htons(port);
 
-            bool closed = receive_icmp6(recv_sock, timeout_ms);
-            std::cout << dst_ip << " " << port << " udp " << (closed ? "closed\n" : "open\n");
+        bool closed = false;
+        int limit;
+        if (!policy.next_port(limit)) break;
+        int attempt = 0;
+        for (; attempt < limit && !closed; ++attempt) {
+            timespec sent = wall_clock_now(), received;
+            sendto(send_sock, nullptr, 0, 0, reinterpret_cast<sockaddr*>(&addr), addr_len);
+            if (packet_recording()) record_datagram<AF>(local, local_port, dst, port, sent);
+            closed = receive_port_unreachable<AF>(recv_sock, dst, port, policy.wait_ms(), received, local);
+            if (closed && attempt == 0) policy.sample(sent, received);
         }
+        policy.finish_port(attempt, closed);
+        report_port(dst_ip, port, "udp", closed ? "closed" : "open");
+    }
+    policy.print(dst_ip, "udp", show_rtt);
 
+    if (!cache) {
         close(send_sock);
         close(recv_sock);
-    } else {
-        int send_sock = socket(AF_INET, SOCK_DGRAM, 0);
-        int recv_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
-        if (send_sock < 0 || recv_sock < 0) {
-            perror("socket");
-            return;
-        }
-
-        for (auto port : ports) {
-            sockaddr_in dst{};
-            dst.sin_family = AF_INET;
-            dst.sin_port = htons(port);
-            inet_pton(AF_INET, dst_ip.c_str(), &dst.sin_addr);
+    }
+}
 
-            sendto(send_sock, nullptr, 0, 0, (sockaddr*)&dst, sizeof(dst));
+/**
+ * @brief The UDP scan of scan_family() as a coroutine on an event loop.
+ *
+ * The task suspends while the socket buffer is full and while it waits for the ICMP error,
+ * so other targets progress in the meantime.
+ *
+ * @param loop Loop owning the sockets; the UDP and ICMP sockets of the family must be open.
+ * @param dst Target address.
+ */
+template <class AF>
+ScanTask UDPScanner::scan_coroutine(ScanLoop &loop, typename AF::addr_type dst) {
+    ProbePolicy policy(timeout_ms, false, 1, min_probes, max_probes, deadline, ports.size());
+    sockaddr_storage addr;
+    socklen_t addr_len = AF::to_sockaddr(dst, addr);
+    typename AF::addr_type local{};
+    if (packet_recording()) local = local_address<AF>(addr, addr_len);
+    for (auto port : ports) {
+        if (AF::family == AF_INET)
+            reinterpret_cast<sockaddr_in*>(&addr)->sin_port = htons(port);
+        else
+            reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port = htons(port);
 
-            bool closed = receive_icmp(recv_sock, timeout_ms);
-            std::cout << dst_ip << " " << port << " udp " << (closed ? "closed\n" : "open\n");
+        bool closed = false;
+        int limit;
+        if (!policy.next_port(limit)) break;
+        int attempt = 0;
+        for (; attempt < limit && !closed; ++attempt) {
+            timespec sent = wall_clock_now();
+            while (!co_await loop.send_udp(addr, addr_len))
+                sent = wall_clock_now();
+            if (packet_recording())
+                record_datagram<AF>(local, loop.udp_source_port(AF::family), dst, port, sent);
+            UdpUnreachableWait<AF> unreachable(loop, dst, port, policy.wait_ms());
+            closed = co_await unreachable;
+            if (closed && attempt == 0) policy.sample(sent, unreachable.stamp);
         }
+        policy.finish_port(attempt, closed);
+        report_port(dst_ip, port, "udp", closed ? "closed" : "open");
+    }
+    policy.print(dst_ip, "udp", show_rtt);
+}
 
-        close(send_sock);
-        close(recv_sock);
+/**
+ * @brief Performs UDP port scan on the target IP address.
+ * 
+ * Uses raw sockets to send empty datagrams and checks for ICMP unreachable replies.
+ */
+void UDPScanner::scan() {
+    in_addr dst4;
+    in6_addr dst6;
+    if (IPv4Family::parse(dst_ip, dst4))
+        scan_family<IPv4Family>(dst4);
+    else if (IPv6Family::parse(dst_ip, dst6))
+        scan_family<IPv6Family>(dst6);
+    else
+        std::cerr << "Invalid destination address " << dst_ip << "\n";
+}
+
+/**
+ * @brief Queues the scan as a coroutine on an event loop.
+ *
+ * @param loop Loop that runs the task and owns the sockets.
+ * @return true If the task was queued or the address is invalid (error printed),
+ *         false if the loop cannot open the sockets for the target's family.
+ */
+bool UDPScanner::schedule(ScanLoop &loop) {
+    in_addr dst4;
+    in6_addr dst6;
+    if (IPv4Family::parse(dst_ip, dst4)) {
+        if (!loop.open_udp(AF_INET)) return false;
+        loop.spawn(scan_coroutine<IPv4Family>(loop, dst4));
+    } else if (IPv6Family::parse(dst_ip, dst6)) {
+        if (!loop.open_udp(AF_INET6)) return false;
+        loop.spawn(scan_coroutine<IPv6Family>(loop, dst6));
+    } else {
+        std::cerr << "Invalid destination address " << dst_ip << "\n";
     }
+    return true;
 }
@@ -0,0 +1,113 @@
+#include "StateDb.hpp"
+#include <cstdlib>
+
+/**
+ * @brief Prints usage information and exits.
+ */
+static void usage() {
+    std::cerr << "usage: ipk-l4-query <db>                                           per-host state counts\n"
+                 "       ipk-l4-query <db> <port>/<tcp|udp> [open|closed|filtered]  hosts with the port in that state\n"
+                 "       ipk-l4-query <db> <ip>                                      all scanned ports of one host\n";
+    exit(1);
+}
+
+/**
+ * @brief Prints how many ports of each host are open, closed and filtered.
+ *
+ * Counts whole bytes (four ports) at a time through a lookup table.
+ */
+static void summary(const StateDb &db) {
+    static uint8_t counts[256][4];
+    for (int b = 0; b < 256; b++)
+        for (int k = 0; k < 4; k++)
+            counts[b][(b >> (k * 2)) & 3]++;
+
+    for (uint32_t i = 0; i < db.host_count(); i++) {
+        std::cout << db.host_name(i);
+        for (StateDb::Proto proto : {StateDb::TCP, StateDb::UDP}) {
+            const uint8_t *states = db.states(i, proto);
+            uint64_t total[4] = {};
+            for (size_t j = 0; j < StateDb::ARRAY_BYTES; j++)
+                for (int s = 1; s < 4; s++)
+                    total[s] += counts[states[j]][s];
+            std::cout << (proto == StateDb::TCP ? " tcp" : " udp")
+                      << " open " << total[StateDb::OPEN] << " closed " << total[StateDb::CLOSED]
+                      << " filtered " << total[StateDb::FILTERED];
+        }
+        std::cout << "\n";
+    }
+}
+
+/**
+ * @brief Prints every host that has the port in the requested state.
+ */
+static void by_port(const StateDb &db, int port, StateDb::Proto proto, StateDb::State state) {
+    for (uint32_t i = 0; i < db.host_count(); i++) {
+        if (StateDb::get(db.states(i, proto), port) == state)
+            std::cout << db.host_name(i) << "\n";
+    }
+}
+
+/**
+ * @brief Prints all scanned ports of one host in the scanner's output format.
+ */
+static bool by_host(const StateDb &db, const std::string &ip) {
+    for (uint32_t i = 0; i < db.host_count(); i++) {
+        if (db.host_name(i) != ip) continue;
+        for (StateDb::Proto proto : {StateDb::TCP, StateDb::UDP}) {
+            const uint8_t *states = db.states(i, proto);
+            for (size_t port = 0; port < StateDb::PORTS; port++) {
+                StateDb::State s = StateDb::get(states, port);
+                if (s != StateDb::UNSCANNED)
+                    std::cout << ip << " " << port << (proto == StateDb::TCP ? " tcp " : " udp ")
+                              << StateDb::name(s) << "\n";
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Entry point of the query tool. Reads the database in place through its mapping.
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return int Exit status code.
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) usage();
+    std::unique_ptr<StateDb> db = StateDb::open(argv[1]);
+    if (!db) return 1;
+
+    if (argc == 2) {
+        summary(*db);
+        return 0;
+    }
+
+    std::string spec = argv[2];
+    size_t slash = spec.find('/');
+    if (slash == std::string::npos) {
+        if (argc != 3) usage();
+        if (!by_host(*db, spec)) {
+            std::cerr << spec << ": not in database\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    char *end;
+    long port = std::strtol(spec.c_str(), &end, 10);
+    std::string proto = spec.substr(slash + 1);
+    if (end != spec.c_str() + slash || port < 0 || port >= static_cast<long>(StateDb::PORTS) ||
+        (proto != "tcp" && proto != "udp"))
+        usage();
+    std::string state = argc == 4 ? argv[3] : "open";
+    StateDb::State s;
+    if (state == "open") s = StateDb::OPEN;
+    else if (state == "closed") s = StateDb::CLOSED;
+    else if (state == "filtered") s = StateDb::FILTERED;
+    else usage();
+    by_port(*db, port, proto == "tcp" ? StateDb::TCP : StateDb::UDP, s);
+    return 0;
+}
@@ -2,9 +2,9 @@
 #define CHAT_CLIENT_H
 
 #include <string>
+#include <map>
 #include <netinet/in.h>
 #include <cstdint>
-#include <thread>
 #include <fcntl.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -14,6 +14,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <unistd.h>
+#include "EventLoop.h"
 
 /**
  * Abstract base class ChatClient.
@@ -80,15 +81,32 @@ public:
     virtual void bye() = 0;
 
     /**
-     * Listens for incoming messages.
-     * This function will be executed in its own thread.
+     * Processes the incoming messages waiting on the socket.
+     * Called by the event loop whenever the socket is readable; returns once the socket would block.
      */
     virtual void listen() = 0;
 
     /**
-     * Starts the listener in a new thread.
+     * Registers the socket with the event loop, which then calls listen() for incoming data
+     * and runs the client's timers.
+     *
+     * @param loop The event loop of the program.
+     */
+    virtual void startListener(EventLoop &loop);
+
+    /**
+     * Tells whether a command is waiting for its REPLY; user input is held back meanwhile.
+     *
+     * @return True while some reply is pending.
+     */
+    bool waitingForReply() const { return !pendingReplies_.empty(); }
+
+    /**
+     * Tells whether sent messages still wait for delivery, so the client must not exit yet.
+     *
+     * @return True if there are unconfirmed messages.
      */
-    virtual void startListener();
+    virtual bool hasPendingOutput() const { return false; }
 
     /**
      * Gracefully ends the connection.
@@ -129,6 +147,25 @@ public:
     int getSockfd() const { return sockfd_; }
 
 protected:
+    /**
+     * Registers a command waiting for its REPLY.
+     * The pending reply is completed by completeReply(); if it is still pending at the deadline,
+     * it is dropped and onTimeout is called.
+     *
+     * @param messageID The ID of the command.
+     * @param timeoutMs The deadline in milliseconds.
+     * @param onTimeout Called when the deadline expires.
+     */
+    void expectReply(uint16_t messageID, int timeoutMs, EventLoop::Handler onTimeout);
+
+    /**
+     * Completes the pending reply of a command and cancels its deadline.
+     *
+     * @param messageID The ID of the command the REPLY belongs to.
+     * @return True if the command was waiting for a reply.
+     */
+    bool completeReply(uint16_t messageID);
+
     std::string hostname_;
     uint16_t port_;
     int sockfd_;
@@ -136,6 +173,8 @@ protected:
     std::string state_;
     uint16_t messageID_;
     std::string displayName_;
+    EventLoop *loop_ = nullptr;
+    std::map<uint16_t, int> pendingReplies_;
 
 };
 
@@ -0,0 +1,102 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+
+/**
+ * EventLoop is a single-threaded reactor built on epoll.
+ * It waits for readable descriptors (stdin, the client socket, a signalfd) and for timers
+ * at the same time, so the client sleeps in the kernel while nothing happens and reacts to
+ * input or network data as soon as it arrives.
+ * Timers are kept in reused slots and a binary heap, so once the loop has warmed up, adding
+ * and cancelling timers does not allocate memory.
+ */
+class EventLoop {
+public:
+    using Handler = std::function<void()>;
+
+    /**
+     * Creates the epoll instance.
+     */
+    EventLoop();
+
+    /**
+     * Closes the epoll instance.
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * Calls a handler whenever a descriptor becomes readable (also on end of file or error).
+     *
+     * @param fd The descriptor to watch.
+     * @param onReadable The handler; it should read until the descriptor would block.
+     * @return false if the descriptor cannot be watched (e.g. a regular file).
+     */
+    bool watch(int fd, Handler onReadable);
+
+    /**
+     * Stops watching a descriptor.
+     *
+     * @param fd The descriptor.
+     */
+    void unwatch(int fd);
+
+    /**
+     * Calls a handler once after a delay.
+     *
+     * @param delayMs The delay in milliseconds.
+     * @param callback The handler.
+     * @return The timer ID, used to cancel it.
+     */
+    int addTimer(int delayMs, Handler callback);
+
+    /**
+     * Cancels a timer that has not fired yet. Unknown IDs are ignored; the ID of a timer that
+     * has fired or was cancelled must not be used again, as it may be given to a new timer.
+     *
+     * @param id The timer ID.
+     */
+    void cancelTimer(int id);
+
+    /**
+     * Dispatches events until the step function returns false.
+     * The step function is called once before the first wait and after every round of events.
+     *
+     * @param step Decides whether to keep running; may also start further work.
+     */
+    void run(const std::function<bool()> &step);
+
+private:
+    struct Timer {
+        Handler callback;
+        int generation = 0;
+        bool active = false;
+    };
+
+    struct Deadline {
+        std::chrono::steady_clock::time_point when;
+        int slot;
+        int generation;
+        bool operator>(const Deadline &other) const { return when > other.when; }
+    };
+
+    int epollfd_;
+    std::map<int, Handler> handlers_;
+    int dispatching_ = -1;
+    bool unwatchDispatching_ = false;
+    std::vector<Timer> timers_;
+    std::vector<int> freeTimers_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+
+    int nextTimeout() const;
+    void fireTimers();
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,37 @@
+#ifndef MESSAGE_ID_WINDOW_H
+#define MESSAGE_ID_WINDOW_H
+
+#include <cstdint>
+
+/**
+ * MessageIDWindow remembers which 16-bit message IDs were already received.
+ * It is a bitmap over the whole ID space (8 KiB) with a sliding window: only the last
+ * WINDOW_SIZE IDs before the newest one are remembered, older ones are forgotten, so an ID
+ * may be used again after the server's counter wraps around. Testing and inserting take
+ * constant time and the memory use never grows.
+ */
+class MessageIDWindow {
+public:
+    /**
+     * Number of IDs remembered behind the newest one (half of the ID space).
+     */
+    static const uint32_t WINDOW_SIZE = 32768;
+
+    /**
+     * Marks an ID as received.
+     *
+     * @param id The message ID.
+     * @return True if the ID was already received before (a duplicate). An ID outside the
+     *         window is forgotten, reported as new and not remembered.
+     */
+    bool testAndSet(uint16_t id);
+
+private:
+    uint64_t bits_[65536 / 64] = {};
+    uint16_t newest_ = 0;
+    bool empty_ = true;
+
+    void clear(uint16_t id) { bits_[id >> 6] &= ~(uint64_t(1) << (id & 63)); }
+};
+
+#endif // MESSAGE_ID_WINDOW_H
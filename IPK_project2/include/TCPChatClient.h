@@ -6,7 +6,6 @@
 #include <iostream>
 #include <sstream>
 #include <chrono>
-#include <thread>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <cstdlib>
@@ -75,8 +74,8 @@ public:
     virtual void bye() override;
 
     /**
-     * Listens for incoming messages on the TCP connection.
-     * This function should run in its own thread.
+     * Reads the data waiting on the TCP connection and processes every complete message.
+     * Partial messages are kept until the rest arrives.
      */
     virtual void listen() override;
 
@@ -89,17 +88,21 @@ private:
     void sendTCP(const std::string &message);
 
     /**
-     * Checks for a reply from the server after sending a command.
-     * This function implements a timeout mechanism for waiting on a reply.
+     * Starts waiting for a reply from the server after sending a command.
+     * If no reply arrives within 5 seconds, an error is sent and the connection ends.
+     * TCP messages carry no IDs, so commands are numbered locally; as input is held back
+     * while a reply is pending, a received REPLY belongs to the only pending command.
+     *
+     * @param messageID The local ID of the command.
      */
-    void checkReply();
+    void checkReply(uint16_t messageID);
 
     /**
      * Handles malformed messages error
      */
     void malformedMessage();
 
-    bool replyReceived_ = false;
+    std::string messageBuffer_;
 };
 
 #endif // TCP_CHAT_CLIENT_H
\ No newline at end of file
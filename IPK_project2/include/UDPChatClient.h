@@ -2,13 +2,14 @@
 #define UDP_CHAT_CLIENT_H
 
 #include "ChatClient.h"
+#include "MessageIDWindow.h"
 #include <vector>
+#include <memory>
 #include <cstdint>
 #include <string>
 #include <iostream>
 #include <cstring>
 #include <chrono>
-#include <thread>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstdlib>
@@ -25,6 +26,25 @@ enum MessageType : uint8_t {
     TYPE_BYE        = 0xFF
 };
 
+/**
+ * An encoded message waiting to be sent or confirmed.
+ * Messages are taken from a pool owned by the client and returned to it once confirmed,
+ * so they are encoded and sent without allocating memory.
+ */
+struct OutgoingMessage {
+    /**
+     * Largest message the client sends: MSG with a 20 character display name and 60000 characters of content.
+     */
+    static const size_t CAPACITY = 3 + 21 + 60001;
+
+    uint8_t data[CAPACITY];
+    size_t length = 0;
+    uint16_t messageID = 0;
+    int attempts = 0;
+    int timer = -1;
+    OutgoingMessage *next = nullptr;
+};
+
 /**
  * UDPChatClient is a concrete implementation of ChatClient for the UDP protocol.
  * It encapsulates all UDP-specific functions such as sending/receiving messages,
@@ -89,36 +109,111 @@ public:
     virtual void bye() override;
 
     /**
-     * Listens for incoming UDP messages. This will be run in a separate thread.
+     * Processes the UDP datagrams waiting on the socket.
+     * After the connection has ended, only CONFIRM messages are still accepted.
      */
     virtual void listen() override;
 
+    /**
+     * Tells whether some sent message is not confirmed yet.
+     *
+     * @return True if some message is in flight or waits for a free slot in the window.
+     */
+    virtual bool hasPendingOutput() const override { return inFlightCount_ != 0 || backlogHead_ != nullptr; }
+
+    /**
+     * Maximum number of messages sent and not yet confirmed.
+     */
+    static const size_t WINDOW_SIZE = 32;
+
 private:
     /**
      * Sends a UDP packet using the internal socket.
+     * Messages are sent while fewer than WINDOW_SIZE
+     * messages are unconfirmed and queued otherwise; every message in flight has its own
+     * retransmission timer and is resent after timeout_ until it is confirmed or retry_count_
+     * is exceeded. MSG messages may overlap, other types are sent only when nothing else is
+     * in flight and hold back the following messages until they are confirmed.
+     *
+     * @param message The encoded message; it is returned to the pool once confirmed.
+     */
+    void sendUDP(OutgoingMessage *message);
+
+    /**
+     * Takes a message from the pool and writes its header.
+     * The pool is allocated for WINDOW_SIZE messages and only grows if more are queued.
+     *
+     * @param type The message type.
+     * @param messageID The message ID.
+     * @return The message, to be filled by append() and passed to sendUDP().
+     */
+    OutgoingMessage *encode(uint8_t type, uint16_t messageID);
+
+    /**
+     * Appends a null-terminated string field to a message.
+     *
+     * @param message The message.
+     * @param field The field content.
+     */
+    static void append(OutgoingMessage *message, const std::string &field);
+
+    /**
+     * Returns a message to the pool.
+     *
+     * @param message The message.
+     */
+    void release(OutgoingMessage *message);
+
+    /**
+     * Moves queued messages into the window while it has room.
+     */
+    void launch();
+
+    /**
+     * Sends a message in flight and starts its retransmission timer.
+     *
+     * @param message The message.
+     */
+    void transmit(OutgoingMessage *message);
+
+    /**
+     * Called when the retransmission timer of a message expires without a confirmation.
+     *
+     * @param message The message.
+     */
+    void retransmit(OutgoingMessage *message);
+
+    /**
+     * Removes a message from the window once it is confirmed.
      *
-     * @param buffer The buffer containing the message.
+     * @param messageID The ID carried by the CONFIRM message.
      */
-    void sendUDP(const std::vector<uint8_t> &buffer);
+    void confirmed(uint16_t messageID);
 
     /**
      * Sends a confirmation message for a given reference message ID.
+     * CONFIRM messages are not confirmed themselves, so they are sent at once from the stack.
      *
      * @param refMessageID The message ID to confirm.
      */
     void confirm(uint16_t refMessageID);
 
     /**
-     * Checks for a reply corresponding to the specified messageID.
-     * This function implements a timeout mechanism (e.g., 5 seconds) using fork.
+     * Starts waiting for a reply corresponding to the specified messageID.
+     * If no reply arrives within 5 seconds, an error is sent and the connection ends.
      *
      * @param messageID The message ID to check.
      */
     void checkReply(uint16_t messageID);
 
-    std::vector<uint16_t> replyIDs_;
-    std::vector<uint16_t> confirmIDs_;
-    std::vector<uint16_t> seenIDs_;
+    MessageIDWindow seenIDs_;
+    std::vector<std::unique_ptr<OutgoingMessage>> pool_;
+    OutgoingMessage *free_ = nullptr;
+    OutgoingMessage *inFlight_[WINDOW_SIZE];
+    size_t inFlightCount_ = 0;
+    OutgoingMessage *backlogHead_ = nullptr;
+    OutgoingMessage *backlogTail_ = nullptr;
+    bool barrier_ = false;
 
     int retry_count_;
     int timeout_;
@@ -54,9 +54,28 @@ void ChatClient::rename(const std::string &displayName) {
     displayName_ = displayName;
 }
 
-void ChatClient::startListener() {
-    std::thread listener([this]() {
-        this->listen();
+void ChatClient::startListener(EventLoop &loop) {
+    loop_ = &loop;
+    if (!loop.watch(sockfd_, [this]() { listen(); })) {
+        std::cout << "ERROR: Cannot watch the socket." << std::endl;
+        exit(1);
+    }
+}
+
+void ChatClient::expectReply(uint16_t messageID, int timeoutMs, EventLoop::Handler onTimeout) {
+    completeReply(messageID);
+    pendingReplies_[messageID] = loop_->addTimer(timeoutMs, [this, messageID, onTimeout]() {
+        pendingReplies_.erase(messageID);
+        onTimeout();
     });
-    listener.detach();
+}
+
+bool ChatClient::completeReply(uint16_t messageID) {
+    auto it = pendingReplies_.find(messageID);
+    if (it == pendingReplies_.end()) {
+        return false;
+    }
+    loop_->cancelTimer(it->second);
+    pendingReplies_.erase(it);
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "EventLoop.h"
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+EventLoop::EventLoop() {
+    epollfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd_ < 0) {
+        std::cout << "ERROR: epoll creation failed." << std::endl;
+        exit(1);
+    }
+}
+
+EventLoop::~EventLoop() {
+    close(epollfd_);
+}
+
+bool EventLoop::watch(int fd, Handler onReadable) {
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return false;
+    }
+    handlers_[fd] = std::move(onReadable);
+    return true;
+}
+
+void EventLoop::unwatch(int fd) {
+    if (handlers_.find(fd) == handlers_.end()) {
+        return;
+    }
+    epoll_ctl(epollfd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (fd == dispatching_) {
+        unwatchDispatching_ = true;
+    } else {
+        handlers_.erase(fd);
+    }
+}
+
+int EventLoop::addTimer(int delayMs, Handler callback) {
+    int slot;
+    if (freeTimers_.empty()) {
+        slot = static_cast<int>(timers_.size());
+        timers_.emplace_back();
+    } else {
+        slot = freeTimers_.back();
+        freeTimers_.pop_back();
+    }
+    Timer &timer = timers_[slot];
+    timer.callback = std::move(callback);
+    timer.active = true;
+    deadlines_.push({std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs), slot, timer.generation});
+    return (slot << 15) | (timer.generation & 0x7fff);
+}
+
+void EventLoop::cancelTimer(int id) {
+    if (id < 0) {
+        return;
+    }
+    size_t slot = static_cast<size_t>(id >> 15);
+    if (slot >= timers_.size() || !timers_[slot].active || (timers_[slot].generation & 0x7fff) != (id & 0x7fff)) {
+        return;
+    }
+    Timer &timer = timers_[slot];
+    timer.active = false;
+    timer.generation++;
+    timer.callback = nullptr;
+    freeTimers_.push_back(static_cast<int>(slot));
+}
+
+int EventLoop::nextTimeout() const {
+    if (deadlines_.empty()) {
+        return -1;
+    }
+    auto left = deadlines_.top().when - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(left).count());
+}
+
+void EventLoop::fireTimers() {
+    auto now = std::chrono::steady_clock::now();
+    while (!deadlines_.empty() && deadlines_.top().when <= now) {
+        Deadline deadline = deadlines_.top();
+        deadlines_.pop();
+        Timer &timer = timers_[deadline.slot];
+        if (!timer.active || timer.generation != deadline.generation) {
+            continue;
+        }
+        Handler callback = std::move(timer.callback);
+        timer.callback = nullptr;
+        timer.active = false;
+        timer.generation++;
+        freeTimers_.push_back(deadline.slot);
+        callback();
+    }
+}
+
+void EventLoop::run(const std::function<bool()> &step) {
+    struct epoll_event events[16];
+    while (step()) {
+        int count = epoll_wait(epollfd_, events, 16, nextTimeout());
+        if (count < 0 && errno != EINTR) {
+            std::cout << "ERROR: epoll_wait failed." << std::endl;
+            exit(1);
+        }
+        for (int i = 0; i < count; i++) {
+            auto it = handlers_.find(events[i].data.fd);
+            if (it != handlers_.end()) {
+                dispatching_ = it->first;
+                it->second();
+                dispatching_ = -1;
+                if (unwatchDispatching_) {
+                    unwatchDispatching_ = false;
+                    handlers_.erase(it);
+                }
+            }
+        }
+        fireTimers();
+    }
+}
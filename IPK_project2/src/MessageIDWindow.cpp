@@ -0,0 +1,26 @@
+#include "MessageIDWindow.h"
+
+bool MessageIDWindow::testAndSet(uint16_t id) {
+    if (empty_) {
+        empty_ = false;
+        newest_ = id;
+    }
+
+    uint16_t ahead = id - newest_;
+    // Exactly WINDOW_SIZE behind: outside the window, and the slide never clears that bit.
+    if (ahead == WINDOW_SIZE) {
+        return false;
+    }
+    if (ahead != 0 && ahead < WINDOW_SIZE) {
+        uint16_t dropped = newest_ - WINDOW_SIZE + 1;
+        for (uint16_t i = 0; i < ahead; i++) {
+            clear(dropped + i);
+        }
+        newest_ = id;
+    }
+
+    uint64_t mask = uint64_t(1) << (id & 63);
+    bool seen = bits_[id >> 6] & mask;
+    bits_[id >> 6] |= mask;
+    return seen;
+}
@@ -36,25 +36,12 @@ void TCPChatClient::sendTCP(const std::string &message) {
     }
 }
 
-void TCPChatClient::checkReply() {
-    replyReceived_ = false;
-    auto startTime = std::chrono::steady_clock::now();
-    const int timeoutMs = 5000;
-
-    while (true) {
-        if (replyReceived_) {
-            break;
-        }
-        auto currentTime = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
-        if (elapsed >= timeoutMs) {
-            std::cout << "ERROR: no reply was received!" << std::endl;
-            sendError("Didn't receive a reply message!");
-            setState("end");
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    }
+void TCPChatClient::checkReply(uint16_t messageID) {
+    expectReply(messageID, 5000, [this]() {
+        std::cout << "ERROR: no reply was received!" << std::endl;
+        sendError("Didn't receive a reply message!");
+        setState("end");
+    });
 }
 
 void TCPChatClient::auth(const std::string &username,
@@ -66,8 +53,7 @@ void TCPChatClient::auth(const std::string &username,
 
     setState("auth");
     sendTCP(message);
-    replyReceived_ = false;
-    checkReply();
+    checkReply(getNextMessageID());
 }
 
 void TCPChatClient::joinChannel(const std::string &channel) {
@@ -75,8 +61,7 @@ void TCPChatClient::joinChannel(const std::string &channel) {
     
     setState("join");
     sendTCP(message);
-    replyReceived_ = false;
-    checkReply();
+    checkReply(getNextMessageID());
 }
 
 void TCPChatClient::sendMessage(const std::string &messageContent) {
@@ -108,35 +93,28 @@ void TCPChatClient::malformedMessage() {
 
 void TCPChatClient::listen() {
     char buffer[1024];
-    std::string messageBuffer;
-
-    int flags = fcntl(sockfd_, F_GETFL, 0);
-    if (flags == -1) {
-        perror("fcntl(F_GETFL) failed");
-    }
-
-    if (fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK) == -1) {
-        perror("fcntl(F_SETFL) failed");
-    }
 
     while (getState() != "end") {
-        ssize_t bytes_received = recv(sockfd_, buffer, sizeof(buffer) - 1, 0);
+        ssize_t bytes_received = recv(sockfd_, buffer, sizeof(buffer) - 1, MSG_DONTWAIT);
         if (bytes_received < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 std::cerr << "ERROR: receiving data failed!" << std::endl;
-                break;
+                setState("end");
             }
+            return;
+        }
+        if (bytes_received == 0) {
+            setState("end");
+            return;
         }
 
         buffer[bytes_received] = '\0';
-        messageBuffer += buffer;        
+        messageBuffer_ += buffer;
 
         size_t pos;
-        while ((pos = messageBuffer.find("\r\n")) != std::string::npos && getState() != "end") {
-            std::string message = messageBuffer.substr(0, pos);
-            messageBuffer.erase(0, pos + 2);
+        while ((pos = messageBuffer_.find("\r\n")) != std::string::npos && getState() != "end") {
+            std::string message = messageBuffer_.substr(0, pos);
+            messageBuffer_.erase(0, pos + 2);
             std::istringstream iss(message);
             std::string command;
             iss >> command;
@@ -170,7 +148,9 @@ void TCPChatClient::listen() {
                 } else if (getState() == "auth" && result == "OK") {
                     setState("open");
                 }
-                replyReceived_ = true;
+                if (!pendingReplies_.empty()) {
+                    completeReply(pendingReplies_.begin()->first);
+                }
             }
             else if (command == "MSG") {
                 if (getState() != "auth") {
@@ -229,5 +209,4 @@ void TCPChatClient::listen() {
             }
         }
     }
-    exit(0);
-}   
\ No newline at end of file
+}
\ No newline at end of file
@@ -18,6 +18,12 @@ UDPChatClient::UDPChatClient(const std::string &hostname, uint16_t port,  int re
         std::cout << "ERROR: Socket creation failed." << std::endl;
         exit(1);
     }
+
+    pool_.reserve(WINDOW_SIZE);
+    for (size_t i = 0; i < WINDOW_SIZE; i++) {
+        pool_.emplace_back(new OutgoingMessage);
+        release(pool_.back().get());
+    }
 }
 
 UDPChatClient::~UDPChatClient() {
@@ -26,183 +32,208 @@ UDPChatClient::~UDPChatClient() {
 void UDPChatClient::connectToServer() {
 }
 
+OutgoingMessage *UDPChatClient::encode(uint8_t type, uint16_t messageID) {
+    OutgoingMessage *message = free_;
+    if (message) {
+        free_ = message->next;
+    } else {
+        pool_.emplace_back(new OutgoingMessage);
+        message = pool_.back().get();
+    }
+
+    MessageHeader header(type, messageID);
+    memcpy(message->data, &header, sizeof(header));
+    message->length = sizeof(header);
+    message->messageID = messageID;
+    message->attempts = 0;
+    message->timer = -1;
+    message->next = nullptr;
+    return message;
+}
+
+void UDPChatClient::append(OutgoingMessage *message, const std::string &field) {
+    size_t length = std::min(field.size(), OutgoingMessage::CAPACITY - message->length - 1);
+    memcpy(message->data + message->length, field.data(), length);
+    message->length += length;
+    message->data[message->length++] = '\0';
+}
+
+void UDPChatClient::release(OutgoingMessage *message) {
+    message->next = free_;
+    free_ = message;
+}
+
 void UDPChatClient::auth(const std::string &username,
                            const std::string &secret,
                            const std::string &displayName) {
     displayName_ = displayName;
     uint16_t msgID = getNextMessageID();
-    uint8_t type = TYPE_AUTH;
-
-    MessageHeader header(type, msgID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
-
-    buffer.insert(buffer.end(), username.begin(), username.end());
-    buffer.push_back('\0');
 
-    buffer.insert(buffer.end(), displayName.begin(), displayName.end());
-    buffer.push_back('\0');
-
-    buffer.insert(buffer.end(), secret.begin(), secret.end());
-    buffer.push_back('\0');
+    OutgoingMessage *message = encode(TYPE_AUTH, msgID);
+    append(message, username);
+    append(message, displayName);
+    append(message, secret);
 
     setState("auth");
-    sendUDP(buffer);
+    sendUDP(message);
     checkReply(msgID);
 }
 
 void UDPChatClient::joinChannel(const std::string &channel) {
     uint16_t msgID = getNextMessageID();
-    uint8_t type = TYPE_JOIN;
-
-    MessageHeader header(type, msgID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
 
-    buffer.insert(buffer.end(), channel.begin(), channel.end());
-    buffer.push_back('\0');
+    OutgoingMessage *message = encode(TYPE_JOIN, msgID);
+    append(message, channel);
+    append(message, displayName_);
 
-    buffer.insert(buffer.end(), displayName_.begin(), displayName_.end());
-    buffer.push_back('\0');
-    
     setState("join");
-    sendUDP(buffer);
+    sendUDP(message);
     checkReply(msgID);
 }
 
-void UDPChatClient::sendMessage(const std::string &message) {
-    uint16_t msgID = getNextMessageID();
-    uint8_t type = TYPE_MSG;
-
-    MessageHeader header(type, msgID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
-    
-    buffer.insert(buffer.end(), displayName_.begin(), displayName_.end());
-    buffer.push_back('\0');
-    
-    buffer.insert(buffer.end(), message.begin(), message.end());
-    buffer.push_back('\0');
-
-    sendUDP(buffer);
+void UDPChatClient::sendMessage(const std::string &messageContent) {
+    OutgoingMessage *message = encode(TYPE_MSG, getNextMessageID());
+    append(message, displayName_);
+    append(message, messageContent);
+
+    sendUDP(message);
 }
 
 void UDPChatClient::sendError(const std::string &error) {
-    uint16_t msgID = getNextMessageID();
-    uint8_t type = TYPE_ERR;
-
-    MessageHeader header(type, msgID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
-    
-    buffer.insert(buffer.end(), displayName_.begin(), displayName_.end());
-    buffer.push_back('\0');
-
-    buffer.insert(buffer.end(), error.begin(), error.end());
-    buffer.push_back('\0');
+    OutgoingMessage *message = encode(TYPE_ERR, getNextMessageID());
+    append(message, displayName_);
+    append(message, error);
 
-    sendUDP(buffer);
+    sendUDP(message);
     setState("end");
 }
 
 void UDPChatClient::bye() {
-    uint16_t msgID = getNextMessageID();
-    
-    uint8_t type = TYPE_BYE;
-    MessageHeader header(type, msgID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
-    
-    if (displayName_ != "") {
-        buffer.insert(buffer.end(), displayName_.begin(), displayName_.end());
-    }
-    else {
-        std::string unknown = "unknown";
-        buffer.insert(buffer.end(), unknown.begin(), unknown.end());
-    }
-    buffer.push_back('\0');
+    static const std::string unknown = "unknown";
 
-    sendUDP(buffer);
+    OutgoingMessage *message = encode(TYPE_BYE, getNextMessageID());
+    append(message, displayName_ != "" ? displayName_ : unknown);
+
+    sendUDP(message);
     setState("end");
 }
 
+void UDPChatClient::sendUDP(OutgoingMessage *message) {
+    if (backlogTail_) {
+        backlogTail_->next = message;
+    } else {
+        backlogHead_ = message;
+    }
+    backlogTail_ = message;
+    launch();
+}
 
-void UDPChatClient::sendUDP(const std::vector<uint8_t> &buffer) {
-    uint8_t type = *reinterpret_cast<const uint8_t*>(buffer.data());
-    uint16_t msgID = ntohs(*reinterpret_cast<const uint16_t*>(buffer.data() + 1));
-    
-    int attempts = 0;
-    
-    while (attempts <= retry_count_) {
-        struct sockaddr_in addr = serverAddr_;
-        ssize_t sentBytes = sendto(sockfd_, buffer.data(), buffer.size(), 0,
-                                   reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
-        if (sentBytes < 0) {
-            if (type == TYPE_ERR) {
-                setState("end");
-                exit(0);
-            }
-            std::cout << "ERROR: Error sending UDP packet" << std::endl;
-        }
-        if (type == TYPE_CONFIRM) 
+void UDPChatClient::launch() {
+    while (backlogHead_ && !barrier_ && inFlightCount_ < WINDOW_SIZE) {
+        OutgoingMessage *message = backlogHead_;
+        bool ordered = message->data[0] != TYPE_MSG;
+        if (ordered && inFlightCount_ != 0) {
             return;
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_));
-        if (std::find(confirmIDs_.begin(), confirmIDs_.end(), msgID) != confirmIDs_.end()) {
-           return;
         }
-        else {
-            attempts++;
+        backlogHead_ = message->next;
+        if (!backlogHead_) {
+            backlogTail_ = nullptr;
         }
+        message->next = nullptr;
+        inFlight_[inFlightCount_++] = message;
+        barrier_ = ordered;
+        transmit(message);
     }
-    
-    std::cout << "ERROR: No confirmation received." << std::endl;
-    setState("end");
 }
 
-void UDPChatClient::confirm(uint16_t refMessageID) {
-    uint8_t type = TYPE_CONFIRM;
-
-    MessageHeader header(type, refMessageID);
-    std::vector<uint8_t> buffer(reinterpret_cast<uint8_t*>(&header),
-                                reinterpret_cast<uint8_t*>(&header) + sizeof(header));
-    sendUDP(buffer);
+void UDPChatClient::transmit(OutgoingMessage *message) {
+    struct sockaddr_in addr = serverAddr_;
+    ssize_t sentBytes = sendto(sockfd_, message->data, message->length, 0,
+                               reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    if (sentBytes < 0) {
+        if (message->data[0] == TYPE_ERR) {
+            setState("end");
+            exit(0);
+        }
+        std::cout << "ERROR: Error sending UDP packet" << std::endl;
+    }
+    message->timer = loop_->addTimer(timeout_, [this, message]() { retransmit(message); });
 }
 
-void UDPChatClient::checkReply(uint16_t messageID) {
-    auto startTime = std::chrono::steady_clock::now();
-    const int timeoutMs = 5000;
-    bool found = false;
+void UDPChatClient::retransmit(OutgoingMessage *message) {
+    message->attempts++;
+    if (message->attempts <= retry_count_) {
+        transmit(message);
+        return;
+    }
 
-    while (true) {
-        if (std::find(replyIDs_.begin(), replyIDs_.end(), messageID) != replyIDs_.end()) {
-            found = true;
-            break;
+    std::cout << "ERROR: No confirmation received." << std::endl;
+    for (size_t i = 0; i < inFlightCount_; i++) {
+        if (inFlight_[i] != message) {
+            loop_->cancelTimer(inFlight_[i]->timer);
         }
-        auto currentTime = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
-        if (elapsed >= timeoutMs) {
-            break;
+        release(inFlight_[i]);
+    }
+    inFlightCount_ = 0;
+    while (backlogHead_) {
+        OutgoingMessage *next = backlogHead_->next;
+        release(backlogHead_);
+        backlogHead_ = next;
+    }
+    backlogTail_ = nullptr;
+    barrier_ = false;
+    setState("end");
+}
+
+void UDPChatClient::confirmed(uint16_t messageID) {
+    for (size_t i = 0; i < inFlightCount_; i++) {
+        OutgoingMessage *message = inFlight_[i];
+        if (message->messageID != messageID) {
+            continue;
+        }
+
+        loop_->cancelTimer(message->timer);
+        inFlight_[i] = inFlight_[--inFlightCount_];
+        release(message);
+        if (inFlightCount_ == 0) {
+            barrier_ = false;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        launch();
+        return;
     }
+}
 
-    if (!found && getState() != "end") {
-        std::cout << "Error: No reply was received." << std::endl;
-        sendError("No reply was received.");
-        setState("end");
+void UDPChatClient::confirm(uint16_t refMessageID) {
+    MessageHeader header(TYPE_CONFIRM, refMessageID);
+    struct sockaddr_in addr = serverAddr_;
+    if (sendto(sockfd_, &header, sizeof(header), 0,
+               reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::cout << "ERROR: Error sending UDP packet" << std::endl;
     }
 }
 
+void UDPChatClient::checkReply(uint16_t messageID) {
+    expectReply(messageID, 5000, [this]() {
+        if (getState() != "end") {
+            std::cout << "Error: No reply was received." << std::endl;
+            sendError("No reply was received.");
+            setState("end");
+        }
+    });
+}
+
 void UDPChatClient::listen() {
     struct sockaddr_in clientAddr;
     socklen_t addrLen = sizeof(clientAddr);
     uint8_t buffer[1024];
 
-    while (getState() != "end") {
-        ssize_t recvLen = recvfrom(sockfd_, buffer, sizeof(buffer) - 1, 0,
+    while (true) {
+        ssize_t recvLen = recvfrom(sockfd_, buffer, sizeof(buffer) - 1, MSG_DONTWAIT,
                                    reinterpret_cast<struct sockaddr*>(&clientAddr), &addrLen);
         if (recvLen > 0) {
+                if (getState() == "end" && buffer[0] != TYPE_CONFIRM) {
+                    continue;
+                }
                 buffer[recvLen] = '\0';
 
                 if (serverAddr_.sin_port != clientAddr.sin_port) {
@@ -213,13 +244,10 @@ void UDPChatClient::listen() {
                 uint16_t recvMessageID = ntohs(*(reinterpret_cast<uint16_t*>(buffer + 1)));
                 
             if (msgType != TYPE_CONFIRM) {
-                if (std::find(seenIDs_.begin(), seenIDs_.end(), recvMessageID) != seenIDs_.end()) {
+                if (seenIDs_.testAndSet(recvMessageID)) {
                     confirm(recvMessageID);
                     continue;
                 }
-                else {
-                    seenIDs_.push_back(recvMessageID);
-                }
             } 
             
             switch (msgType) {
@@ -241,9 +269,7 @@ void UDPChatClient::listen() {
                         setState("end");
                     }
 
-                    if (std::find(replyIDs_.begin(), replyIDs_.end(), refMessageID) == replyIDs_.end()) {
-                        replyIDs_.push_back(refMessageID);
-                    }
+                    completeReply(refMessageID);
                     
                     confirm(recvMessageID);
                     break;
@@ -286,9 +312,7 @@ void UDPChatClient::listen() {
                     break;
                 }
                 case TYPE_CONFIRM: {
-                    if (std::find(confirmIDs_.begin(), confirmIDs_.end(), recvMessageID) == confirmIDs_.end()) {
-                        confirmIDs_.push_back(recvMessageID);
-                    }
+                    confirmed(recvMessageID);
                     break;
                 }
                 default:
@@ -299,8 +323,10 @@ void UDPChatClient::listen() {
                     break;
             }
         } else if (recvLen < 0) {
-            std::cout << "ERROR: Error receiving UDP message." << std::endl;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cout << "ERROR: Error receiving UDP message." << std::endl;
+            }
+            return;
         }
     }
-    exit(0);
 }
\ No newline at end of file
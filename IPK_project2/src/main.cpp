@@ -2,23 +2,96 @@
 #include "UDPChatClient.h"
 #include "TCPChatClient.h"
 #include "Utils.h"
+#include "EventLoop.h"
+#include <deque>
+#include <sys/signalfd.h>
 
-int tcp_sockfd_global = -1;
-std::unique_ptr<ChatClient> client;
+static void handleInput(ChatClient &client, std::string input) {
+    input.erase(input.begin(), std::find_if(input.begin(), input.end(), [](unsigned char ch) {
+        return !std::isspace(ch);
+    }));
+    input.erase(std::find_if(input.rbegin(), input.rend(), [](unsigned char ch) {
+        return !std::isspace(ch);
+    }).base(), input.end());
+    if (input.empty()) { 
+        return;
+    }
+    std::vector<std::string> tokens = split(input);
+    if (tokens.empty()) {
+        return;
+    }
 
-int main(int argc, char *argv[]) {
-    std::signal(SIGINT, [](int) {
-        client->bye();
-        if (tcp_sockfd_global != -1) {
-            if (shutdown(tcp_sockfd_global, SHUT_RDWR) < 0) {
-                std::cerr << "ERROR: Shutdown failed!" << std::endl;
+    if (tokens[0] == "/auth" && tokens.size() == 4) {
+        if (client.getState() == "start" || client.getState() == "auth") { 
+            std::string username = tokens[1];
+            std::string secret = tokens[2];
+            std::string displayName = tokens[3];
+
+            if (username.size() <= 20 && secret.size() <= 128 && displayName.size() <= 20) {
+                if (isValidString(username) && isValidString(secret) && isPrintableChar(displayName)) {
+                    client.auth(username, secret, displayName);
+                } else {
+                    std::cout << "ERROR: Invalid characters in username, secret, or display name!" << std::endl;
+                }
+            } else {
+                std::cout << "ERROR: Username, secret, or display name too long!" << std::endl;
             }
-            close(tcp_sockfd_global);
-            tcp_sockfd_global = -1;
         }
-        exit(0);
-    });
-    
+        else {
+            std::cout << "ERROR: Already authorized!" << std::endl;
+        }
+    }
+    else if (tokens[0] == "/join" && tokens.size() == 2) {
+        std::string channel = tokens[1];
+        if (channel.size() <= 20 && isValidString(channel)) {
+            if (client.getState() == "open") {
+                client.joinChannel(channel);
+            } else {
+                std::cout << "ERROR: Cant join channel in current state!" << std::endl;
+            }
+        }
+        else {
+            std::cout << "ERROR: Invalid characters in channel name or too long!" << std::endl;
+        }
+    }
+    else if (tokens[0] == "/rename" && tokens.size() == 2) {
+        std::string displayName = tokens[1];
+        if (displayName.size() <= 20 && isPrintableChar(displayName)) { 
+            client.rename(displayName);
+        }
+        else {
+            std::cout << "ERROR: Name is too long or containing invalid characters!" << std::endl;
+        }
+    }
+    else if (tokens[0] == "/bye" && tokens.size() == 1) {
+        client.bye();
+    }
+    else if (tokens[0] == "/help" && tokens.size() == 1) {
+        commandHelp();
+    }
+    else if (tokens[0][0] != '/') {
+        if (client.getState() == "open") {
+            if (isValidMessage(input)) {
+                if (input.size() <= 60000) {
+                    client.sendMessage(input);
+                }
+                else {
+                    client.sendMessage(input.substr(0, 60000));
+                }
+            } else {
+                std::cout << "ERROR: Invalid message content.\n";
+            }
+        }
+        else {
+            std::cout << "ERROR: Cannot send message in current state.\n";
+        }
+    }
+    else {
+        std::cout << "ERROR: Unknown or malformed command.\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
     if (argc == 2 && std::string(argv[1]) == "-h") {
         help();
     }
@@ -30,118 +103,80 @@ int main(int argc, char *argv[]) {
         help();
     }
 
+    std::unique_ptr<ChatClient> client;
     if (opts.protocol == "udp") {
         client = std::make_unique<UDPChatClient>(opts.hostname, opts.port, opts.retry_count, opts.timeout);
     } else if (opts.protocol == "tcp") {
         client = std::make_unique<TCPChatClient>(opts.hostname, opts.port);
-        tcp_sockfd_global = client->getSockfd();
     } else {
         std::cout << "ERROR: Invalid protocol specified: " << opts.protocol << "\n";
         return 1;
     }
 
+    EventLoop loop;
     client->connectToServer();
+    client->startListener(loop);
 
-    client->startListener();
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop.watch(sigfd, [&]() {
+        struct signalfd_siginfo info;
+        while (read(sigfd, &info, sizeof(info)) > 0) {
+        }
+        if (client->getState() == "end") {
+            exit(0);
+        }
+        client->bye();
+    });
 
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
 
-    char buffer[1024];
-    std::string input;
-
-    while (client->getState() != "end") {
-        ssize_t bytes = read(STDIN_FILENO, buffer, sizeof(buffer) - 1);
-        if (bytes > 0) {
-            buffer[bytes] = '\0';
-            std::string input(buffer);
-            input.erase(input.begin(), std::find_if(input.begin(), input.end(), [](unsigned char ch) {
-                return !std::isspace(ch);
-            }));
-            input.erase(std::find_if(input.rbegin(), input.rend(), [](unsigned char ch) {
-                return !std::isspace(ch);
-            }).base(), input.end());
-            if (input.empty()) { 
-                continue;
-            }
-            std::vector<std::string> tokens = split(input);
-            if (tokens.empty()) {
-                continue;
-            }
-
-            if (tokens[0] == "/auth" && tokens.size() == 4) {
-                if (client->getState() == "start" || client->getState() == "auth") { 
-                    std::string username = tokens[1];
-                    std::string secret = tokens[2];
-                    std::string displayName = tokens[3];
+    std::string partial;
+    std::deque<std::string> lines;
+    bool inputClosed = false;
 
-                    if (username.size() <= 20 && secret.size() <= 128 && displayName.size() <= 20) {
-                        if (isValidString(username) && isValidString(secret) && isPrintableChar(displayName)) {
-                            client->auth(username, secret, displayName);
-                        } else {
-                            std::cout << "ERROR: Invalid characters in username, secret, or display name!" << std::endl;
-                        }
-                    } else {
-                        std::cout << "ERROR: Username, secret, or display name too long!" << std::endl;
-                    }
-                }
-                else {
-                    std::cout << "ERROR: Already authorized!" << std::endl;
+    auto readInput = [&]() {
+        char buffer[4096];
+        while (!inputClosed) {
+            ssize_t bytes = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (bytes > 0) {
+                partial.append(buffer, bytes);
+                size_t pos;
+                while ((pos = partial.find('\n')) != std::string::npos) {
+                    lines.push_back(partial.substr(0, pos));
+                    partial.erase(0, pos + 1);
                 }
             }
-            else if (tokens[0] == "/join" && tokens.size() == 2) {
-                std::string channel = tokens[1];
-                if (channel.size() <= 20 && isValidString(channel)) {
-                    if (client->getState() == "open") {
-                        client->joinChannel(channel);
-                    } else {
-                        std::cout << "ERROR: Cant join channel in current state!" << std::endl;
-                    }
-                }
-                else {
-                    std::cout << "ERROR: Invalid characters in channel name or too long!" << std::endl;
+            else if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                if (!partial.empty()) {
+                    lines.push_back(partial);
                 }
+                inputClosed = true;
+                loop.unwatch(STDIN_FILENO);
             }
-            else if (tokens[0] == "/rename" && tokens.size() == 2) {
-                std::string displayName = tokens[1];
-                if (displayName.size() <= 20 && isPrintableChar(displayName)) { 
-                    client->rename(displayName);
-                }
-                else {
-                    std::cout << "ERROR: Name is too long or containing invalid characters!" << std::endl;
-                }
-            }
-            else if (tokens[0] == "/bye" && tokens.size() == 1) {
-                client->bye();
-            }
-            else if (tokens[0] == "/help" && tokens.size() == 1) {
-                commandHelp();
-            }
-            else if (tokens[0][0] != '/') {
-                if (client->getState() == "open") {
-                    if (isValidMessage(input)) {
-                        if (input.size() <= 60000) {
-                            client->sendMessage(input);
-                        }
-                        else {
-                            client->sendMessage(input.substr(0, 60000));
-                        }
-                    } else {
-                        std::cout << "ERROR: Invalid message content.\n";
-                    }
-                }
-                else {
-                    std::cout << "ERROR: Cannot send message in current state.\n";
-                }
-            }
-            else {
-                std::cout << "ERROR: Unknown or malformed command.\n";
+            else if (errno != EINTR) {
+                break;
             }
         }
-        else if (bytes == 0) {
+    };
+    if (!loop.watch(STDIN_FILENO, readInput)) {
+        readInput();
+    }
+
+    loop.run([&]() {
+        while (!lines.empty() && client->getState() != "end" && !client->waitingForReply()) {
+            std::string line = lines.front();
+            lines.pop_front();
+            handleInput(*client, line);
+        }
+        if (inputClosed && lines.empty() && client->getState() != "end" && !client->waitingForReply()) {
             client->bye();
-            client->setState("end");
         }
-    }
+        return client->getState() != "end" || client->hasPendingOutput();
+    });
     return 0;
-}
\ No newline at end of file
+}